@@ -0,0 +1,277 @@
+#ifndef ANALYSIS_SERVER_H
+#define ANALYSIS_SERVER_H
+
+#include "ast_serialization.h"
+#include "diagnostics.h"
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Long-running analyzer for editor integrations, so a check costs neither
+// process start nor prelude setup. Requests and responses are single
+// lines over a Unix stream socket:
+//
+//   check PATH   analyze the flat program file at PATH (see write_program)
+//   stats        request count and retained memory
+//   shutdown     stop serving after answering
+//
+// A check answers with one JSON object,
+//   {"ok":true,"passed":false,"micros":412,"errors":[...],"type_errors":[...]}
+// holding DiagnosticReporter's JSON records, and any failure with
+// {"ok":false,"error":"..."}. Between requests the server keeps the
+// prelude, the interned names, the analyzer with its global scope and the
+// request program with its arena, so a warm check allocates little beyond
+// what the new program needs. Program files are only read once they pass
+// MappedFlatAST's checksum and structure checks.
+//
+// Open connections are multiplexed with poll, each for as many requests
+// as its client sends, so an idle client does not hold up the others.
+// Requests run one at a time on the serving thread. A request line longer
+// than kMaxRequestBytes is answered with a failure and its connection is
+// closed, as is a connection whose client stops reading its responses.
+class AnalysisServer {
+public:
+    static constexpr size_t kMaxRequestBytes = 64 * 1024;
+    static constexpr size_t kMaxConnections = 64;
+
+private:
+    struct Connection {
+        int fd;
+        std::string buffer;
+    };
+
+
+    std::deque<ProgramNode> libraries;
+    Scope prelude;
+    std::vector<Diagnostic> prelude_errors;
+    ScopeAnalyzer analyzer;
+    ProgramNode program;
+    DiagnosticReporter json{DiagnosticFormat::Json};
+    uint64_t requests = 0;
+    bool stopping = false;
+
+    static std::string failure(const std::string& message) {
+        return "{\"ok\":false,\"error\":" + DiagnosticReporter::json_string(message) + "}\n";
+    }
+
+    // format_all's JSON array without its trailing newline.
+    template<typename D>
+    std::string json_array(const std::vector<D>& diagnostics) const {
+        std::string out = json.format_all(diagnostics);
+        out.pop_back();
+        return out;
+    }
+
+    std::string check(const std::string& path) {
+        auto start = std::chrono::steady_clock::now();
+        analyzer.reset();
+        program.clear();
+        std::string error;
+        if (!read_program(path, program, &error)) return failure(error);
+        bool passed = analyzer.check(&program);
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::string out = "{\"ok\":true,\"passed\":";
+        out += passed ? "true" : "false";
+        out += ",\"micros\":" + std::to_string(micros);
+        out += ",\"errors\":" + json_array(analyzer.getErrors());
+        out += ",\"type_errors\":" + json_array(analyzer.getTypeErrors());
+        out += "}\n";
+        return out;
+    }
+
+    static bool write_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    static std::string too_long() {
+        return failure("request longer than " + std::to_string(kMaxRequestBytes) + " bytes");
+    }
+
+    // Reads what poll reported as ready on c and answers every complete
+    // request line. Returns false once the connection should be closed.
+    bool serve_input(Connection& c) {
+        char chunk[4096];
+        ssize_t n = ::read(c.fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) return true;
+        if (n <= 0) return false;
+        c.buffer.append(chunk, (size_t)n);
+        size_t begin = 0, end;
+        while (!stopping && (end = c.buffer.find('\n', begin)) != std::string::npos) {
+            if (end - begin > kMaxRequestBytes) {
+                write_all(c.fd, too_long());
+                return false;
+            }
+            if (!write_all(c.fd, handle(c.buffer.substr(begin, end - begin)))) return false;
+            begin = end + 1;
+        }
+        c.buffer.erase(0, begin);
+        if (c.buffer.size() > kMaxRequestBytes) {
+            write_all(c.fd, too_long());
+            return false;
+        }
+        return true;
+    }
+
+    // Accepts one pending connection, if any is still there. Responses
+    // are written with a timeout so a client that never reads cannot stall
+    // the server.
+    void accept_connection(int listener, std::vector<Connection>& connections) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) return;
+        if (connections.size() >= kMaxConnections) {
+            write_all(fd, failure("too many connections"));
+            ::close(fd);
+            return;
+        }
+        timeval timeout{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        connections.push_back({fd, std::string()});
+    }
+
+public:
+    explicit AnalysisServer(const AnalyzerOptions& opts = AnalyzerOptions()) : analyzer(prelude, opts) {}
+
+    AnalysisServer(const AnalysisServer&) = delete;
+    AnalysisServer& operator=(const AnalysisServer&) = delete;
+
+    // Declares the globals and functions of the flat program at path in
+    // the prelude every request is checked against. Call before serving.
+    bool add_prelude(const std::string& path, std::string* error = nullptr) {
+        libraries.emplace_back();
+        if (!read_program(path, libraries.back(), error)) {
+            libraries.pop_back();
+            return false;
+        }
+        declare_globals(&libraries.back(), prelude, prelude_errors);
+        return true;
+    }
+
+    const std::vector<Diagnostic>& getPreludeErrors() const { return prelude_errors; }
+
+    // Answers one request line, given without its newline.
+    std::string handle(const std::string& request) {
+        ++requests;
+        if (request.compare(0, 6, "check ") == 0) return check(request.substr(6));
+        if (request == "stats") {
+            return "{\"ok\":true,\"requests\":" + std::to_string(requests)
+                 + ",\"symbols\":" + std::to_string(interner().size())
+                 + ",\"arena_bytes\":" + std::to_string(program.arena.capacity()) + "}\n";
+        }
+        if (request == "shutdown") {
+            stopping = true;
+            return "{\"ok\":true}\n";
+        }
+        return failure("unknown request: " + request);
+    }
+
+    // Listens on socket_path, replacing a stale socket file, and serves
+    // until a shutdown request. Returns false and sets *error if the
+    // socket cannot be set up.
+    bool serve(const std::string& socket_path, std::string* error = nullptr) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            if (error) *error = socket_path + ": socket path too long";
+            return false;
+        }
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            if (error) *error = std::string("socket: ") + std::strerror(errno);
+            return false;
+        }
+        ::unlink(socket_path.c_str());
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listener, 16) != 0) {
+            if (error) *error = socket_path + ": " + std::strerror(errno);
+            ::close(listener);
+            return false;
+        }
+
+        // Non-blocking, so a client that is gone before accept cannot block it.
+        ::fcntl(listener, F_SETFL, ::fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+        stopping = false;
+        std::vector<Connection> connections;
+        std::vector<pollfd> fds;
+        while (!stopping) {
+            fds.clear();
+            fds.push_back({listener, POLLIN, 0});
+            for (auto& c : connections) fds.push_back({c.fd, POLLIN, 0});
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                if (error) *error = std::string("poll: ") + std::strerror(errno);
+                break;
+            }
+            for (size_t i = 1; i < fds.size() && !stopping; ++i) {
+                Connection& c = connections[i - 1];
+                if (fds[i].revents && !serve_input(c)) {
+                    ::close(c.fd);
+                    c.fd = -1;
+                }
+            }
+            connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                             [](const Connection& c) { return c.fd < 0; }),
+                              connections.end());
+            if (!stopping && (fds[0].revents & POLLIN)) accept_connection(listener, connections);
+        }
+        for (auto& c : connections) ::close(c.fd);
+        ::close(listener);
+        ::unlink(socket_path.c_str());
+        return stopping;
+    }
+};
+
+// Client side: sends one request line to the server at socket_path and
+// stores its response line, newline included, in *response.
+inline bool send_request(const std::string& socket_path, const std::string& request, std::string* response,
+                         std::string* error = nullptr) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        if (error) *error = socket_path + ": socket path too long";
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (error) *error = socket_path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+
+    std::string line = request + "\n";
+    bool ok = ::send(fd, line.data(), line.size(), MSG_NOSIGNAL) == (ssize_t)line.size();
+    response->clear();
+    char chunk[4096];
+    while (ok && (response->empty() || response->back() != '\n')) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = false;
+        else response->append(chunk, (size_t)n);
+    }
+    ::close(fd);
+    if (!ok && error) *error = socket_path + ": connection closed";
+    return ok;
+}
+
+#endif
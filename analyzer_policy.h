@@ -0,0 +1,55 @@
+#ifndef ANALYZER_POLICY_H
+#define ANALYZER_POLICY_H
+
+// Compile-time configuration of BasicScopeWalker and BasicScopeAnalyzer.
+// Every choice is a type whose constants are tested with `if constexpr`,
+// so each configuration is compiled to its own traversal and the branches
+// it does not use are not in the binary.
+
+// Diagnostic sinks.
+struct RecordDiagnostics {
+    static constexpr bool records = true;
+};
+
+// Keeps no diagnostics at all: the first error ends the traversal and only
+// the verdict is reported. The compiled form of AnalyzerOptions::verdict_only.
+struct VerdictOnly {
+    static constexpr bool records = false;
+};
+
+// Shadowing rules for declarations inside functions.
+struct AllowShadowing {
+    static constexpr bool shadowing = true;
+};
+
+// A local may not reuse the name of a parameter or of a local of an
+// enclosing scope; doing so is reported as VariableRedefined. Globals may
+// still be shadowed.
+struct ForbidShadowing {
+    static constexpr bool shadowing = false;
+};
+
+// Scope models: which statements open a scope besides blocks.
+struct ForLoopScope {
+    static constexpr bool for_scope = true;    // the initializer is local to the loop
+};
+
+struct BlockScopesOnly {
+    static constexpr bool for_scope = false;   // the initializer is declared in the enclosing scope
+};
+
+template<typename Sink = RecordDiagnostics, typename Shadowing = AllowShadowing, typename Scoping = ForLoopScope>
+struct AnalyzerPolicy {
+    using sink = Sink;
+    using shadowing_rule = Shadowing;
+    using scope_model = Scoping;
+
+    static constexpr bool records = Sink::records;
+    static constexpr bool shadowing = Shadowing::shadowing;
+    static constexpr bool for_scope = Scoping::for_scope;
+};
+
+using DefaultPolicy = AnalyzerPolicy<>;
+using VerdictPolicy = AnalyzerPolicy<VerdictOnly>;
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef ANALYZER_STATS_H
+#define ANALYZER_STATS_H
+
+#include "parse_tree.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Build with -DSCOPE_ANALYZER_STATS=1 to collect AnalyzerStats. Otherwise
+// every counter update compiles to nothing and the stats stay zero.
+#ifndef SCOPE_ANALYZER_STATS
+#define SCOPE_ANALYZER_STATS 0
+#endif
+
+#if SCOPE_ANALYZER_STATS
+#define ANALYZER_STAT(statement) do { statement; } while (0)
+#else
+#define ANALYZER_STAT(statement) do { } while (0)
+#endif
+
+enum class AnalyzerPhase {
+    Declarations,
+    Bodies,
+    Initializers
+};
+
+inline const char* analyzer_phase_name(AnalyzerPhase phase) {
+    switch (phase) {
+        case AnalyzerPhase::Declarations: return "global declarations";
+        case AnalyzerPhase::Bodies: return "function bodies";
+        case AnalyzerPhase::Initializers: return "global initializers";
+    }
+    return "";
+}
+
+struct AnalyzerStats {
+    static constexpr bool enabled = SCOPE_ANALYZER_STATS != 0;
+    static constexpr size_t kPhases = 3;
+    static constexpr size_t kKinds = (size_t)NodeKind::Program + 1;
+
+    // Phase start, relative to the start of check(), and duration.
+    double phase_start[kPhases] = {};
+    double phase_seconds[kPhases] = {};
+    uint64_t nodes[kKinds] = {};
+    uint64_t scopes_entered = 0;
+    uint32_t peak_scope_depth = 0;
+    // Global-scope lookups and the number of scopes they looked at,
+    // walking from the program scope up its parent chain.
+    uint64_t global_lookups = 0;
+    uint64_t scopes_walked = 0;
+
+    uint64_t total_nodes() const {
+        uint64_t total = 0;
+        for (uint64_t n : nodes) total += n;
+        return total;
+    }
+
+    double average_chain_depth() const {
+        return global_lookups ? (double)scopes_walked / global_lookups : 0.0;
+    }
+
+    // Adds the counters of a worker; phase times are not merged.
+    void merge(const AnalyzerStats& other) {
+        for (size_t k = 0; k < kKinds; ++k) nodes[k] += other.nodes[k];
+        scopes_entered += other.scopes_entered;
+        if (other.peak_scope_depth > peak_scope_depth) peak_scope_depth = other.peak_scope_depth;
+        global_lookups += other.global_lookups;
+        scopes_walked += other.scopes_walked;
+    }
+};
+
+// Start time for PhaseTimer; does not read the clock when stats are off.
+inline std::chrono::steady_clock::time_point stats_clock() {
+#if SCOPE_ANALYZER_STATS
+    return std::chrono::steady_clock::now();
+#else
+    return std::chrono::steady_clock::time_point();
+#endif
+}
+
+// Records the wall time of one phase into stats while in scope.
+class PhaseTimer {
+#if SCOPE_ANALYZER_STATS
+    AnalyzerStats& stats;
+    size_t phase;
+    std::chrono::steady_clock::time_point origin, start;
+
+public:
+    PhaseTimer(AnalyzerStats& s, AnalyzerPhase p, std::chrono::steady_clock::time_point check_start)
+        : stats(s), phase((size_t)p), origin(check_start), start(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        auto end = std::chrono::steady_clock::now();
+        stats.phase_start[phase] = std::chrono::duration<double>(start - origin).count();
+        stats.phase_seconds[phase] = std::chrono::duration<double>(end - start).count();
+    }
+#else
+public:
+    PhaseTimer(AnalyzerStats&, AnalyzerPhase, std::chrono::steady_clock::time_point) {}
+#endif
+};
+
+// Writes stats in the Chrome trace event format (chrome://tracing,
+// Perfetto): one complete event per phase and the counters as arguments
+// of the body phase.
+inline void write_chrome_trace(std::ostream& os, const AnalyzerStats& stats) {
+    std::string out = "{\"traceEvents\":[";
+    for (size_t p = 0; p < AnalyzerStats::kPhases; ++p) {
+        if (p) out += ',';
+        out += "{\"name\":\"";
+        out += analyzer_phase_name((AnalyzerPhase)p);
+        out += "\",\"cat\":\"scope\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":";
+        out += std::to_string((uint64_t)(stats.phase_start[p] * 1e6));
+        out += ",\"dur\":";
+        out += std::to_string((uint64_t)(stats.phase_seconds[p] * 1e6));
+        if ((AnalyzerPhase)p == AnalyzerPhase::Bodies) {
+            out += ",\"args\":{\"nodes\":" + std::to_string(stats.total_nodes());
+            out += ",\"scopes_entered\":" + std::to_string(stats.scopes_entered);
+            out += ",\"peak_scope_depth\":" + std::to_string(stats.peak_scope_depth);
+            out += ",\"global_lookups\":" + std::to_string(stats.global_lookups);
+            out += ",\"scopes_walked\":" + std::to_string(stats.scopes_walked) + "}";
+        }
+        out += '}';
+    }
+    out += "]}\n";
+    os.write(out.data(), (std::streamsize)out.size());
+    os.flush();
+}
+
+#endif
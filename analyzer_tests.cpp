@@ -0,0 +1,699 @@
+// Behavior checks for the analyzers layered on ScopeAnalyzer. Each one is
+// run next to a fresh ScopeAnalyzer::check of the same generated programs
+// and must report the same diagnostics (matches_fresh); small hand-made
+// programs check what is specific to each analyzer.
+//
+//   g++ -std=c++17 -O2 -pthread analyzer_tests.cpp -o analyzer_tests
+//   ./analyzer_tests
+//
+// Prints every failed check and exits with status 1 if there was one.
+#include "analysis_server.h"
+#include "ast_generator.h"
+#include "batch_analyzer.h"
+#include "flat_analyzer.h"
+#include "incremental_analyzer.h"
+#include "result_cache.h"
+#include "scope_analyzer.h"
+#include "streaming_analyzer.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+size_t checks = 0;
+size_t failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+void check(bool ok, const char* what, const char* file, int line) {
+    ++checks;
+    if (ok) return;
+    ++failures;
+    std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+}
+
+bool same_diagnostics(const std::vector<Diagnostic>& a, const std::vector<Diagnostic>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].kind != b[i].kind || a[i].name != b[i].name || a[i].loc.line != b[i].loc.line
+            || a[i].loc.column != b[i].loc.column) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool same_type_diagnostics(const std::vector<TypeDiagnostic>& a, const std::vector<TypeDiagnostic>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].kind != b[i].kind || a[i].name != b[i].name || a[i].loc.line != b[i].loc.line
+            || a[i].loc.column != b[i].loc.column || a[i].expected != b[i].expected || a[i].actual != b[i].actual) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename A, typename = void>
+struct has_type_errors : std::false_type {};
+template<typename A>
+struct has_type_errors<A, std::void_t<decltype(std::declval<A&>().getTypeErrors())>> : std::true_type {};
+
+// Runs a fresh ScopeAnalyzer on program with the options analyzer ran
+// with and compares verdicts and diagnostics, type diagnostics included
+// for analyzers that report them.
+template<typename Analyzer>
+bool matches_fresh(Analyzer& analyzer, ProgramNode& program, const AnalyzerOptions& options = AnalyzerOptions()) {
+    ScopeAnalyzer fresh(options);
+    bool passed = fresh.check(&program);
+    if (analyzer.passed() != passed || !same_diagnostics(analyzer.getErrors(), fresh.getErrors())) return false;
+    if constexpr (has_type_errors<Analyzer>::value) {
+        return same_type_diagnostics(analyzer.getTypeErrors(), fresh.getTypeErrors());
+    }
+    return true;
+}
+
+// The option sets every analyzer is compared under.
+std::vector<AnalyzerOptions> option_sets() {
+    std::vector<AnalyzerOptions> sets;
+    for (bool types : {false, true}) {
+        for (size_t max_errors : {0, 1, 3, 17}) {
+            AnalyzerOptions o;
+            o.check_types = types;
+            o.max_errors = max_errors;
+            sets.push_back(o);
+        }
+        AnalyzerOptions verdict;
+        verdict.check_types = types;
+        verdict.verdict_only = true;
+        sets.push_back(verdict);
+    }
+    return sets;
+}
+
+std::vector<Diagnostic> fresh_errors(ProgramNode& program, const AnalyzerOptions& options = AnalyzerOptions()) {
+    ScopeAnalyzer analyzer(options);
+    analyzer.check(&program);
+    return analyzer.takeErrors();
+}
+
+// Calls f on every node of root's subtree, parameters included.
+template<typename F>
+void for_each_node(ASTNode* root, F&& f) {
+    std::vector<ASTNode*> work{root};
+    while (!work.empty()) {
+        ASTNode* node = work.back();
+        work.pop_back();
+        if (!node) continue;
+        f(node);
+        if (node->kind() == NodeKind::Function) {
+            for (auto& param : static_cast<FunctionNode*>(node)->params) work.push_back(&param);
+        }
+        for_each_child(node, [&](const ASTNode* child) { work.push_back(const_cast<ASTNode*>(child)); });
+    }
+}
+
+// The generator leaves locations unknown; give every node its own line.
+void number_lines(ProgramNode& program) {
+    uint32_t line = 0;
+    for (auto& var : program.globals) for_each_node(&var, [&](ASTNode* node) { node->loc = {++line, 1}; });
+    for (auto& func : program.functions) for_each_node(&func, [&](ASTNode* node) { node->loc = {++line, 1}; });
+}
+
+ProgramNode& generate(ProgramNode& program, uint64_t seed, size_t functions = 40) {
+    GeneratorConfig config;
+    config.functions = functions;
+    config.globals = 20;
+    config.error_rate = 0.02;
+    config.seed = seed;
+    ASTGenerator(config).generate(program);
+    number_lines(program);
+    return program;
+}
+
+// First NameNode of func's body, or null.
+NameNode* first_name(FunctionNode& func) {
+    NameNode* found = nullptr;
+    if (func.body) {
+        for_each_node(func.body, [&](ASTNode* node) {
+            if (!found && node->kind() == NodeKind::Name) found = static_cast<NameNode*>(node);
+        });
+    }
+    return found;
+}
+
+// -- Hand-made programs -----------------------------------------------------
+
+// Adds `ret name() { statements }`, with nodes made in program's arena.
+FunctionNode& add_function(ProgramNode& program, const char* ret, const char* name,
+                           std::initializer_list<ASTNode*> statements = {}) {
+    FunctionNode& func = program.add_function(Symbol(ret), Symbol(name));
+    auto body = program.make<BlockNode>();
+    body->statements.assign(statements.begin(), statements.end());
+    func.body = body;
+    return func;
+}
+
+VariableNode* variable(ProgramNode& program, const char* type, const char* name, ASTNode* value = nullptr) {
+    auto var = program.make<VariableNode>(Symbol(type), Symbol(name));
+    var->value = value;
+    return var;
+}
+
+NameNode* name_node(ProgramNode& program, const char* name) { return program.make<NameNode>(Symbol(name)); }
+
+// int f() {        // line 10
+//     missing;     // line 12
+// }
+// Returns the `missing` name, for tests that move it.
+NameNode* missing_name_program(ProgramNode& program) {
+    NameNode* name = name_node(program, "missing");
+    name->loc = {12, 5};
+    FunctionNode& f = add_function(program, "int", "f", {name});
+    f.loc = {10, 1};
+    f.body->loc = {11, 1};
+    return name;
+}
+
+// -- IncrementalAnalyzer ----------------------------------------------------
+
+// An edit that only moves a line re-checks the function and reports the
+// new line.
+void test_incremental_move_only_edit() {
+    ProgramNode program;
+    NameNode* name = missing_name_program(program);
+    IncrementalAnalyzer incremental;
+    incremental.check(&program);
+    CHECK(incremental.errorCount() == 1 && incremental.getErrors()[0].loc.line == 12);
+
+    name->loc.line = 13;
+    ProgramEdit edit;
+    edit.functions.push_back(&program.functions[0]);
+    incremental.update(&program, edit);
+    CHECK(incremental.recheckedCount() == 1);
+    CHECK(incremental.errorCount() == 1 && incremental.getErrors()[0].loc.line == 13);
+}
+
+void test_incremental_edits() {
+    for (uint64_t seed = 1; seed <= 10; ++seed) {
+        ProgramNode program;
+        generate(program, seed);
+        IncrementalAnalyzer incremental;
+        incremental.check(&program);
+        CHECK(matches_fresh(incremental, program));
+
+        // Edit one body: break a name and move part of the function.
+        FunctionNode& edited = program.functions[seed % program.functions.size()];
+        if (NameNode* name = first_name(edited)) name->name = Symbol("undeclared_edit");
+        for_each_node(edited.body, [](ASTNode* node) { node->loc.line += 3; });
+        ProgramEdit edit;
+        edit.functions.push_back(&edited);
+        incremental.update(&program, edit);
+        CHECK(matches_fresh(incremental, program));
+
+        // Move another function as a whole, without telling the analyzer.
+        FunctionNode& moved = program.functions[(seed + 1) % program.functions.size()];
+        for_each_node(&moved, [](ASTNode* node) { node->loc.line += 1000; });
+        incremental.update(&program, ProgramEdit());
+        CHECK(incremental.recheckedCount() == 0);
+        CHECK(matches_fresh(incremental, program));
+
+        // Remove a global: every unit that used it is re-checked.
+        program.globals.erase(program.globals.begin());
+        incremental.update(&program, ProgramEdit());
+        CHECK(matches_fresh(incremental, program));
+
+        // Remove a function: the ones shifted into its slot are not it.
+        program.functions.erase(program.functions.begin());
+        incremental.update(&program, ProgramEdit());
+        CHECK(matches_fresh(incremental, program));
+    }
+}
+
+// Erasing f moves g into f's slot; g must not replay f's error.
+void test_incremental_erase_function() {
+    ProgramNode program;
+    add_function(program, "int", "f", {name_node(program, "missing")}).loc = {1, 1};
+    add_function(program, "int", "g").loc = {2, 1};
+
+    IncrementalAnalyzer incremental;
+    incremental.check(&program);
+    CHECK(incremental.errorCount() == 1);
+    program.functions.erase(program.functions.begin());
+    incremental.update(&program, ProgramEdit());
+    CHECK(incremental.errorCount() == 0);
+    CHECK(incremental.recheckedCount() == 1);
+}
+
+// -- CachedAnalyzer ---------------------------------------------------------
+
+std::string temp_cache_dir(const char* name) {
+    std::string dir = "/tmp/analyzer_tests_" + std::string(name) + "_" + std::to_string((long)::getpid());
+    std::system(("rm -rf " + dir).c_str());
+    return dir;
+}
+
+// A line moved inside the function misses; the whole function moved hits
+// and reports the new lines.
+void test_cache_move_only_edit() {
+    ProgramNode program;
+    NameNode* name = missing_name_program(program);
+    std::string dir = temp_cache_dir("move");
+    ResultCache cache(dir);
+    CachedAnalyzer cached(cache);
+    cached.check(&program);
+    CHECK(cached.hitCount() == 0 && cached.errorCount() == 1 && cached.getErrors()[0].loc.line == 12);
+    cached.check(&program);
+    CHECK(cached.hitCount() == 1);
+
+    name->loc.line = 13;
+    cached.check(&program);
+    CHECK(cached.hitCount() == 0 && cached.errorCount() == 1 && cached.getErrors()[0].loc.line == 13);
+
+    for_each_node(&program.functions[0], [](ASTNode* node) { node->loc.line += 100; });
+    cached.check(&program);
+    CHECK(cached.hitCount() == 1 && cached.errorCount() == 1 && cached.getErrors()[0].loc.line == 113);
+    std::system(("rm -rf " + dir).c_str());
+}
+
+void test_cache_hits_and_limits() {
+    std::string dir = temp_cache_dir("limits");
+    ResultCache cache(dir);
+    for (uint64_t seed = 1; seed <= 5; ++seed) {
+        ProgramNode program;
+        generate(program, seed);
+        for (const AnalyzerOptions& options : option_sets()) {
+            for (unsigned threads : {1u, 4u}) {
+                AnalyzerOptions o = options;
+                o.threads = threads;
+                CachedAnalyzer cached(cache, o);
+                cached.check(&program);   // miss, or hit from an earlier option set
+                CHECK(matches_fresh(cached, program, o));
+                cached.check(&program);
+                CHECK(cached.hitCount() == program.functions.size());
+                CHECK(matches_fresh(cached, program, o));
+            }
+        }
+
+        // A changed body misses; the others still hit.
+        FunctionNode& edited = program.functions[seed % program.functions.size()];
+        if (NameNode* name = first_name(edited)) name->name = Symbol("undeclared_edit");
+        CachedAnalyzer cached(cache);
+        cached.check(&program);
+        CHECK(cached.hitCount() + 1 == program.functions.size() || !first_name(edited));
+        CHECK(matches_fresh(cached, program, AnalyzerOptions()));
+    }
+    std::system(("rm -rf " + dir).c_str());
+}
+
+// -- BatchAnalyzer ----------------------------------------------------------
+
+void test_batch() {
+    ProgramNode library;
+    generate(library, 100, 10);
+    Scope prelude;
+    std::vector<Diagnostic> prelude_errors;
+    declare_globals(&library, prelude, prelude_errors);
+
+    std::vector<ProgramNode> programs(12);
+    std::vector<ProgramNode*> units;
+    for (size_t u = 0; u < programs.size(); ++u) units.push_back(&generate(programs[u], 200 + u, 10 + u));
+
+    for (const AnalyzerOptions& options : option_sets()) {
+        for (unsigned threads : {1u, 4u}) {
+            AnalyzerOptions o = options;
+            o.threads = threads;
+            BatchAnalyzer batch(o);
+            batch.add_prelude(&library);
+            bool passed = batch.check(units);
+            CHECK(batch.getPreludeErrors().empty());
+            CHECK(batch.getResults().size() == units.size());
+
+            AnalyzerOptions unit_options = o;
+            unit_options.threads = 1;
+            bool all_passed = true;
+            for (size_t u = 0; u < units.size(); ++u) {
+                ScopeAnalyzer fresh(prelude, unit_options);
+                all_passed &= fresh.check(units[u]);
+                // Units after a failure may be skipped under these options.
+                if (o.verdict_only || o.stop_at_first_error) continue;
+                const UnitResult& result = batch.getResults()[u];
+                CHECK(same_diagnostics(result.errors, fresh.getErrors()));
+                CHECK(same_type_diagnostics(result.type_errors, fresh.getTypeErrors()));
+            }
+            CHECK(passed == all_passed);
+        }
+    }
+}
+
+// -- Link pass --------------------------------------------------------------
+
+// Errors of a fresh run of unit that link() keeps: undefined calls stay
+// only if no unit defines the function.
+std::vector<Diagnostic> expected_after_link(ProgramNode& unit, const std::vector<ProgramNode*>& units) {
+    std::vector<Diagnostic> kept;
+    for (const Diagnostic& d : fresh_errors(unit)) {
+        bool defined = false;
+        for (ProgramNode* other : units) {
+            for (auto& func : other->functions) defined |= func.name == d.name;
+        }
+        if (d.kind != ScopeError::UndefinedFunction || !defined) kept.push_back(d);
+    }
+    return kept;
+}
+
+void test_link() {
+    std::vector<ProgramNode> programs(6);
+    std::vector<ProgramNode*> units;
+    for (size_t u = 0; u < programs.size(); ++u) units.push_back(&generate(programs[u], 300 + u, 20));
+    // Half of the functions each unit calls but does not define are
+    // defined, without a body, by the next unit.
+    size_t undefined = 0, defined_elsewhere = 0;
+    for (size_t u = 0; u < units.size(); ++u) {
+        ProgramNode& next = *units[(u + 1) % units.size()];
+        for (const Diagnostic& d : fresh_errors(*units[u])) {
+            if (d.kind != ScopeError::UndefinedFunction || ++undefined % 2) continue;
+            bool defined = false;
+            for (auto& func : next.functions) defined |= func.name == d.name;
+            if (!defined) next.add_function(Symbol("int"), d.name).loc = {9999, 1};
+            ++defined_elsewhere;
+        }
+    }
+
+    // Type checks change nothing about which scope errors are linked.
+    AnalyzerOptions with_types;
+    with_types.check_types = true;
+    BatchAnalyzer typed(with_types);
+    typed.check(units);
+    typed.link(units);
+
+    BatchAnalyzer batch;
+    batch.check(units);
+    batch.link(units);
+    size_t remaining = 0;
+    for (size_t u = 0; u < units.size(); ++u) {
+        CHECK(same_diagnostics(batch.getResults()[u].errors, expected_after_link(*units[u], units)));
+        CHECK(same_diagnostics(typed.getResults()[u].errors, batch.getResults()[u].errors));
+        for (auto& d : batch.getResults()[u].errors) remaining += d.kind == ScopeError::UndefinedFunction;
+    }
+    CHECK(defined_elsewhere > 0 && remaining > 0);
+
+    // The same link against an index written to a file and mapped back.
+    LinkIndex built;
+    for (size_t u = 0; u < units.size(); ++u) built.add_unit((uint32_t)u, *units[u]);
+    built.finish();
+    std::string path = "/tmp/analyzer_tests_" + std::to_string((long)::getpid()) + ".lnk";
+    std::string error;
+    CHECK(built.write(path, &error));
+    LinkIndex mapped;
+    CHECK(mapped.open(path, &error));
+    CHECK(mapped.size() == built.size());
+    BatchAnalyzer from_file;
+    from_file.check(units);
+    from_file.link(mapped);
+    for (size_t u = 0; u < units.size(); ++u) {
+        CHECK(same_diagnostics(from_file.getResults()[u].errors, batch.getResults()[u].errors));
+    }
+    std::remove(path.c_str());
+}
+
+// `void f() { int v = ext(); }` in one unit and `ret ext() { return value; }`
+// in another, checked with types and linked.
+UnitResult linked_call(const char* ret, ASTNode* (*make_value)(ProgramNode&)) {
+    ProgramNode caller, callee;
+    add_function(caller, "void", "f", {variable(caller, "int", "v", caller.make<CallNode>(Symbol("ext")))});
+    auto ret_stmt = callee.make<ReturnNode>();
+    ret_stmt->value = make_value(callee);
+    add_function(callee, ret, "ext", {ret_stmt});
+
+    AnalyzerOptions options;
+    options.check_types = true;
+    BatchAnalyzer batch(options);
+    std::vector<ProgramNode*> units{&caller, &callee};
+    batch.check(units);
+    CHECK(!batch.passed());
+    bool passed = batch.link(units);
+    CHECK(passed == (batch.getResults()[0].passed() && batch.getResults()[1].passed()));
+    return batch.getResults()[0];
+}
+
+void test_link_types() {
+    UnitResult same = linked_call("int", [](ProgramNode& p) -> ASTNode* { return p.make<LiteralNode>((int64_t)1); });
+    CHECK(same.passed());
+    // The linked signature is checked: ext returns float, not int.
+    UnitResult other = linked_call("float", [](ProgramNode& p) -> ASTNode* { return p.make<LiteralNode>(1.5); });
+    CHECK(other.errors.empty() && other.type_errors.size() == 1);
+    CHECK(!other.type_errors.empty() && other.type_errors[0].kind == TypeError::ErroneousVarDecl
+          && other.type_errors[0].actual == BasicType::Float);
+}
+
+// -- StreamingAnalyzer ------------------------------------------------------
+
+void test_streaming() {
+    for (uint64_t seed = 1; seed <= 5; ++seed) {
+        ProgramNode program;
+        generate(program, 400 + seed);
+        for (const AnalyzerOptions& options : option_sets()) {
+            StreamingAnalyzer streaming(options);
+            for (auto& var : program.globals) streaming.declare_global(&var);
+            for (auto& func : program.functions) streaming.declare_function(func);
+            for (auto& func : program.functions) streaming.check_body(&func);
+            streaming.finish();
+            CHECK(matches_fresh(streaming, program, options));
+        }
+    }
+}
+
+// -- FlatScopeAnalyzer ------------------------------------------------------
+
+void test_flat() {
+    for (uint64_t seed = 1; seed <= 5; ++seed) {
+        ProgramNode program;
+        generate(program, 500 + seed);
+        FlatAST flat = flatten(program);
+        for (const AnalyzerOptions& set : option_sets()) {
+            if (set.check_types) continue;
+            for (unsigned threads : {1u, 4u}) {
+                AnalyzerOptions options = set;
+                options.threads = threads;
+                FlatScopeAnalyzer analyzer(options);
+                analyzer.check(flat.view());
+                CHECK(matches_fresh(analyzer, program, set));
+            }
+        }
+    }
+}
+
+// -- Policies ---------------------------------------------------------------
+
+// Large bodies are split into parts across the workers; every policy must
+// give the same result as one thread.
+template<typename Policy>
+void test_policy_parallel() {
+    for (uint64_t seed = 1; seed <= 10; ++seed) {
+        GeneratorConfig config;
+        config.functions = 20;
+        config.globals = 20;
+        config.large_functions = 2;
+        config.large_width = 400;
+        config.error_rate = 0.02;
+        config.seed = 600 + seed;
+        for (bool types : {false, true}) {
+            for (size_t max_errors : {0, 1, 3, 17, 100}) {
+                AnalyzerOptions options;
+                options.check_types = types;
+                options.max_errors = max_errors;
+                ProgramNode sequential_program, parallel_program;
+                ASTGenerator(config).generate(sequential_program);
+                ASTGenerator(config).generate(parallel_program);
+                number_lines(sequential_program);
+                number_lines(parallel_program);
+                BasicScopeAnalyzer<Policy> sequential(options);
+                sequential.check(&sequential_program);
+                options.threads = 4;
+                BasicScopeAnalyzer<Policy> parallel(options);
+                parallel.check(&parallel_program);
+                CHECK(parallel.passed() == sequential.passed());
+                if constexpr (Policy::records) {
+                    CHECK(same_diagnostics(parallel.getErrors(), sequential.getErrors()));
+                    CHECK(same_type_diagnostics(parallel.getTypeErrors(), sequential.getTypeErrors()));
+                }
+            }
+        }
+    }
+}
+
+template<typename Policy>
+std::vector<Diagnostic> policy_errors(ProgramNode& program) {
+    BasicScopeAnalyzer<Policy> analyzer;
+    analyzer.check(&program);
+    return analyzer.getErrors();
+}
+
+// void f(int p) { int p; int x; { int x; } }
+void shadowing_program(ProgramNode& program) {
+    auto inner = program.make<BlockNode>();
+    inner->statements.push_back(variable(program, "int", "x"));
+    FunctionNode& f = add_function(program, "void", "f", {variable(program, "int", "p"), variable(program, "int", "x"), inner});
+    f.params.emplace_back(Symbol("int"), Symbol("p"));
+}
+
+// void g() { for (int i = 0; i; ) { } i; int i; }
+void loop_program(ProgramNode& program) {
+    auto loop = program.make<ForNode>();
+    loop->initializer = variable(program, "int", "i", program.make<LiteralNode>((int64_t)0));
+    loop->condition = name_node(program, "i");
+    loop->body = program.make<BlockNode>();
+    add_function(program, "void", "g", {loop, name_node(program, "i"), variable(program, "int", "i")});
+}
+
+void test_policy_rules() {
+    using Forbid = AnalyzerPolicy<RecordDiagnostics, ForbidShadowing>;
+    using BlocksOnly = AnalyzerPolicy<RecordDiagnostics, AllowShadowing, BlockScopesOnly>;
+    ProgramNode shadows, loops;
+    shadowing_program(shadows);
+    loop_program(loops);
+
+    CHECK(policy_errors<DefaultPolicy>(shadows).empty());
+    std::vector<Diagnostic> forbidden = policy_errors<Forbid>(shadows);
+    CHECK(forbidden.size() == 2);
+    for (auto& d : forbidden) CHECK(d.kind == ScopeError::VariableRedefined);
+    CHECK(forbidden.size() == 2 && forbidden[0].name == Symbol("p") && forbidden[1].name == Symbol("x"));
+    BasicScopeAnalyzer<AnalyzerPolicy<VerdictOnly, ForbidShadowing>> verdict;
+    CHECK(!verdict.check(&shadows) && verdict.getErrors().empty());
+
+    // The loop variable is local to the loop by default...
+    std::vector<Diagnostic> scoped = policy_errors<DefaultPolicy>(loops);
+    CHECK(scoped.size() == 1 && scoped[0].kind == ScopeError::UndeclaredVariable);
+    // ...and belongs to the function's block without for scopes.
+    std::vector<Diagnostic> unscoped = policy_errors<BlocksOnly>(loops);
+    CHECK(unscoped.size() == 1 && unscoped[0].kind == ScopeError::VariableRedefined);
+}
+
+void test_policies() {
+    test_policy_rules();
+    test_policy_parallel<AnalyzerPolicy<RecordDiagnostics, AllowShadowing, ForLoopScope>>();
+    test_policy_parallel<AnalyzerPolicy<RecordDiagnostics, AllowShadowing, BlockScopesOnly>>();
+    test_policy_parallel<AnalyzerPolicy<RecordDiagnostics, ForbidShadowing, ForLoopScope>>();
+    test_policy_parallel<AnalyzerPolicy<RecordDiagnostics, ForbidShadowing, BlockScopesOnly>>();
+    test_policy_parallel<AnalyzerPolicy<VerdictOnly, AllowShadowing, ForLoopScope>>();
+    test_policy_parallel<AnalyzerPolicy<VerdictOnly, AllowShadowing, BlockScopesOnly>>();
+    test_policy_parallel<AnalyzerPolicy<VerdictOnly, ForbidShadowing, ForLoopScope>>();
+    test_policy_parallel<AnalyzerPolicy<VerdictOnly, ForbidShadowing, BlockScopesOnly>>();
+}
+
+// -- AnalysisServer ---------------------------------------------------------
+
+bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+void test_server() {
+    std::string dir = temp_cache_dir("server");
+    std::system(("mkdir -p " + dir).c_str());
+    std::string socket_path = dir + "/scope.sock", good = dir + "/good.ast", bad = dir + "/bad.ast";
+    ProgramNode program;
+    generate(program, 700);
+    CHECK(write_program(program, good));
+    ScopeAnalyzer fresh;
+    bool passed = fresh.check(&program);
+
+    // The same file with one payload byte flipped.
+    std::system(("cp " + good + " " + bad).c_str());
+    if (FILE* f = std::fopen(bad.c_str(), "r+b")) {
+        std::fseek(f, -8, SEEK_END);
+        int c = std::fgetc(f);
+        std::fseek(f, -8, SEEK_END);
+        std::fputc(c ^ 0x5a, f);
+        std::fclose(f);
+    }
+
+    AnalysisServer server;
+    bool served = false;
+    std::thread thread([&] { served = server.serve(socket_path); });
+    std::string response;
+    for (int i = 0; i < 1000 && !send_request(socket_path, "stats", &response); ++i) ::usleep(1000);
+    CHECK(contains(response, "\"ok\":true"));
+
+    // An idle connection must not keep the others waiting.
+    int idle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    CHECK(::connect(idle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    CHECK(::send(idle, "sta", 3, MSG_NOSIGNAL) == 3);
+
+    CHECK(send_request(socket_path, "check " + good, &response));
+    CHECK(contains(response, "\"ok\":true"));
+    CHECK(contains(response, passed ? "\"passed\":true" : "\"passed\":false"));
+    CHECK(send_request(socket_path, "check " + bad, &response));
+    CHECK(contains(response, "\"ok\":false"));
+    CHECK(send_request(socket_path, std::string(AnalysisServer::kMaxRequestBytes + 1, 'x'), &response));
+    CHECK(contains(response, "request longer than"));
+
+    CHECK(send_request(socket_path, "shutdown", &response));
+    thread.join();
+    ::close(idle);
+    CHECK(served);
+    std::system(("rm -rf " + dir).c_str());
+}
+
+// -- TypeChecker ------------------------------------------------------------
+
+// Type errors of `void f() { int v = value; }`, with v's initializer
+// built by make_value in the program's arena.
+template<typename F>
+size_t initializer_type_errors(F&& make_value) {
+    ProgramNode program;
+    add_function(program, "void", "f", {variable(program, "int", "v", make_value(program))});
+    AnalyzerOptions options;
+    options.check_types = true;
+    ScopeAnalyzer analyzer(options);
+    analyzer.check(&program);
+    return analyzer.getTypeErrors().size();
+}
+
+BinaryOpNode* times_two(ProgramNode& program, ASTNode* left) {
+    auto times = program.make<BinaryOpNode>("*");
+    times->left = left;
+    times->right = program.make<LiteralNode>((int64_t)2);
+    return times;
+}
+
+void test_type_poison() {
+    // Unresolved operands are reported by the scope pass only.
+    CHECK(initializer_type_errors([](ProgramNode& p) { return name_node(p, "unknown_var"); }) == 0);
+    CHECK(initializer_type_errors([](ProgramNode& p) { return times_two(p, name_node(p, "unknown_var")); }) == 0);
+    CHECK(initializer_type_errors([](ProgramNode& p) { return times_two(p, p.make<CallNode>(Symbol("ext"))); }) == 0);
+    // A failed operator is reported once, not again by the declaration.
+    CHECK(initializer_type_errors([](ProgramNode& p) { return times_two(p, p.make<LiteralNode>(true)); }) == 1);
+    CHECK(initializer_type_errors([](ProgramNode& p) {
+        return times_two(p, times_two(p, p.make<LiteralNode>(Symbol("text"))));
+    }) == 1);
+    // A known operand of the wrong type is still reported.
+    CHECK(initializer_type_errors([](ProgramNode& p) { return p.make<LiteralNode>(true); }) == 1);
+}
+
+}
+
+int main() {
+    test_incremental_move_only_edit();
+    test_incremental_edits();
+    test_incremental_erase_function();
+    test_cache_move_only_edit();
+    test_cache_hits_and_limits();
+    test_batch();
+    test_link();
+    test_link_types();
+    test_streaming();
+    test_flat();
+    test_policies();
+    test_type_poison();
+    test_server();
+
+    std::cout << checks << " checks, " << failures << " failed" << std::endl;
+    return failures ? 1 : 0;
+}
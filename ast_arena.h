@@ -0,0 +1,143 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator that owns every node of a tree. Nodes are carved out of
+// large chunks and released all at once when the arena is cleared or
+// destroyed; nodes with members that need cleanup (strings, vectors) get
+// their destructor run from a flat list, so freeing a tree never recurses.
+class ASTArena {
+    struct Finalizer {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    static constexpr size_t kFirstChunkSize = 64 * 1024;
+    static constexpr size_t kMaxChunkSize = 1024 * 1024;
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    // chunks[0, used) hold objects; the rest were kept by reset().
+    std::vector<Chunk> chunks;
+    size_t used = 0;
+    std::vector<Finalizer> finalizers;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t next_chunk_size = kFirstChunkSize;
+
+    // Continues in the next kept chunk of at least `bytes`, or a new one.
+    void next_chunk(size_t bytes) {
+        while (used < chunks.size() && chunks[used].size < bytes) chunks.erase(chunks.begin() + used);
+        if (used == chunks.size()) chunks.push_back({std::unique_ptr<char[]>(new char[bytes]), bytes});
+        cursor = chunks[used].data.get();
+        limit = cursor + chunks[used].size;
+        ++used;
+    }
+
+    void* allocate_slow(size_t size, size_t align) {
+        size_t chunk_size = next_chunk_size;
+        if (size + align > chunk_size) chunk_size = size + align;
+        if (next_chunk_size < kMaxChunkSize) next_chunk_size *= 2;
+
+        next_chunk(chunk_size);
+        return allocate(size, align);
+    }
+
+public:
+    ASTArena() = default;
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+
+    ASTArena(ASTArena&& other) noexcept { *this = std::move(other); }
+
+    ASTArena& operator=(ASTArena&& other) noexcept {
+        if (this != &other) {
+            clear();
+            chunks = std::move(other.chunks);
+            used = other.used;
+            finalizers = std::move(other.finalizers);
+            cursor = other.cursor;
+            limit = other.limit;
+            next_chunk_size = other.next_chunk_size;
+            other.chunks.clear();
+            other.used = 0;
+            other.finalizers.clear();
+            other.cursor = other.limit = nullptr;
+            other.next_chunk_size = kFirstChunkSize;
+        }
+        return *this;
+    }
+
+    ~ASTArena() { clear(); }
+
+    void* allocate(size_t size, size_t align) {
+        uintptr_t p = reinterpret_cast<uintptr_t>(cursor);
+        uintptr_t aligned = (p + align - 1) & ~(uintptr_t)(align - 1);
+        if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            return allocate_slow(size, align);
+        }
+        cursor = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        void* mem = allocate(sizeof(T), alignof(T));
+        T* obj = new (mem) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            finalizers.push_back({obj, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+        return obj;
+    }
+
+    // Makes sure the next `bytes` of allocations fit without growing.
+    void reserve(size_t bytes) {
+        if (cursor && (size_t)(limit - cursor) >= bytes) return;
+        next_chunk(bytes);
+    }
+
+    // Destroys every object allocated so far and releases the memory.
+    void clear() {
+        reset();
+        chunks.clear();
+    }
+
+    // Destroys every object allocated so far but keeps the chunks, so a
+    // long-running process that builds one tree after another stops
+    // allocating once the arena has grown to the largest tree.
+    void reset() {
+        for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it) {
+            it->destroy(it->object);
+        }
+        finalizers.clear();
+        used = 0;
+        cursor = limit = nullptr;
+        next_chunk_size = kFirstChunkSize;
+    }
+
+    // Bytes of chunk memory held, in use or kept.
+    size_t capacity() const {
+        size_t total = 0;
+        for (auto& c : chunks) total += c.size;
+        return total;
+    }
+
+    // Bytes of the chunks in use, less the unused end of the current one.
+    size_t used_bytes() const {
+        size_t total = 0;
+        for (size_t i = 0; i < used; ++i) total += chunks[i].size;
+        return total - (size_t)(limit - cursor);
+    }
+};
+
+#endif
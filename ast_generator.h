@@ -0,0 +1,213 @@
+#ifndef AST_GENERATOR_H
+#define AST_GENERATOR_H
+
+#include "parse_tree.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+struct GeneratorConfig {
+    size_t functions = 1000;
+    size_t globals = 100;
+    size_t params = 3;          // per function
+    size_t depth = 3;           // maximum block nesting inside a body
+    size_t width = 6;           // statements per block
+    size_t large_functions = 0; // functions whose body has large_width statements
+    size_t large_width = 2000;
+    size_t expr_terms = 4;      // maximum operands in one expression
+    double reuse = 0.5;         // chance a declaration reuses a visible name (shadowing)
+    double error_rate = 0.0;    // chance a use names something undeclared
+    uint64_t seed = 1;
+};
+
+struct GeneratorStats {
+    size_t nodes = 0;
+    size_t lookups = 0;         // name resolutions: names, assignments, calls
+    size_t declarations = 0;
+};
+
+// Builds random but mostly well-formed programs for benchmarking the
+// analyzer. Uses only names that are visible at the point of use unless
+// error_rate asks otherwise, so a generated program exercises lookups
+// along the whole scope chain.
+class ASTGenerator {
+    GeneratorConfig config;
+    std::mt19937_64 rng;
+    ProgramNode* program = nullptr;
+    GeneratorStats stats;
+    std::vector<Symbol> visible;          // locals and globals in scope
+    std::vector<size_t> scope_marks;
+    std::vector<Symbol> function_names;
+    size_t fresh = 0;
+    const Symbol int_type = "int";   // interned once, not per declaration
+
+    size_t pick(size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); }
+    bool chance(double p) { return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p; }
+
+    template<typename T, typename... Args>
+    T* node(Args&&... args) {
+        ++stats.nodes;
+        return program->make<T>(std::forward<Args>(args)...);
+    }
+
+    Symbol fresh_name(const char* prefix) { return Symbol(prefix + std::to_string(fresh++)); }
+
+    Symbol use_name() {
+        ++stats.lookups;
+        if (visible.empty() || chance(config.error_rate)) return fresh_name("undeclared_");
+        return visible[pick(visible.size())];
+    }
+
+    Symbol declare_name() {
+        ++stats.declarations;
+        size_t start = scope_marks.empty() ? 0 : scope_marks.back();
+        // Reuse only names from outer scopes so reuse shadows instead of
+        // redefining in the same scope.
+        if (start > 0 && chance(config.reuse)) {
+            Symbol name = visible[pick(start)];
+            bool taken = false;
+            for (size_t i = start; i < visible.size(); ++i) taken |= visible[i] == name;
+            if (!taken) return name;
+        }
+        return fresh_name("v");
+    }
+
+    void push_scope() { scope_marks.push_back(visible.size()); }
+    void pop_scope() { visible.resize(scope_marks.back()); scope_marks.pop_back(); }
+
+    ASTNode* operand() {
+        size_t roll = pick(4);
+        if (roll == 0) return node<LiteralNode>((int64_t)pick(100));
+        if (roll == 1 && !function_names.empty()) {
+            ++stats.lookups;
+            auto call = node<CallNode>();
+            call->name = chance(config.error_rate) ? fresh_name("missing_") : function_names[pick(function_names.size())];
+            size_t args = pick(3);
+            for (size_t i = 0; i < args; ++i) call->args.push_back(node<NameNode>(use_name()));
+            return call;
+        }
+        return node<NameNode>(use_name());
+    }
+
+    ASTNode* expression() {
+        static const char* ops[] = {"+", "-", "*", "<"};
+        ASTNode* expr = operand();
+        size_t terms = 1 + pick(config.expr_terms);
+        for (size_t i = 1; i < terms; ++i) {
+            auto bin = node<BinaryOpNode>(ops[pick(4)]);
+            bin->left = expr;
+            bin->right = operand();
+            expr = bin;
+        }
+        return expr;
+    }
+
+    ASTNode* statement(size_t depth) {
+        size_t roll = pick(depth < config.depth ? 7 : 3);
+        switch (roll) {
+            case 0: {
+                Symbol name = declare_name();
+                auto var = node<VariableNode>(int_type, name);
+                var->value = expression();
+                visible.push_back(name);
+                return var;
+            }
+            case 1: {
+                auto assign = node<AssignmentNode>(use_name());
+                assign->value = expression();
+                return assign;
+            }
+            case 2: {
+                auto ret = node<ReturnNode>();
+                ret->value = expression();
+                return ret;
+            }
+            case 3: {
+                auto if_stmt = node<IfNode>();
+                if_stmt->condition = expression();
+                if_stmt->then_branch = block(depth + 1);
+                if (chance(0.5)) if_stmt->else_branch = block(depth + 1);
+                return if_stmt;
+            }
+            case 4: {
+                auto while_stmt = node<WhileNode>();
+                while_stmt->condition = expression();
+                while_stmt->body = block(depth + 1);
+                return while_stmt;
+            }
+            case 5: {
+                auto for_stmt = node<ForNode>();
+                push_scope();
+                Symbol i = declare_name();
+                auto init = node<VariableNode>(int_type, i);
+                init->value = node<LiteralNode>(int64_t(0));
+                for_stmt->initializer = init;
+                visible.push_back(i);
+                for_stmt->condition = expression();
+                auto inc = node<AssignmentNode>(i);
+                ++stats.lookups;
+                inc->value = expression();
+                for_stmt->increment = inc;
+                for_stmt->body = block(depth + 1);
+                pop_scope();
+                return for_stmt;
+            }
+            default:
+                return block(depth + 1);
+        }
+    }
+
+    BlockNode* block(size_t depth) { return block(depth, 1 + pick(config.width)); }
+
+    BlockNode* block(size_t depth, size_t count) {
+        auto b = node<BlockNode>();
+        push_scope();
+        b->statements.reserve(count);
+        for (size_t i = 0; i < count; ++i) b->statements.push_back(statement(depth));
+        pop_scope();
+        return b;
+    }
+
+public:
+    explicit ASTGenerator(const GeneratorConfig& cfg) : config(cfg), rng(cfg.seed) {}
+
+    const GeneratorStats& getStats() const { return stats; }
+
+    void generate(ProgramNode& out) {
+        program = &out;
+        stats = GeneratorStats();
+        visible.clear();
+        scope_marks.clear();
+        function_names.clear();
+
+        out.reserve(out.functions.size() + config.functions, out.globals.size() + config.globals);
+        for (size_t i = 0; i < config.globals; ++i) {
+            Symbol name = fresh_name("g");
+            out.add_global(int_type, name).value = node<LiteralNode>((int64_t)i);
+            visible.push_back(name);
+            ++stats.nodes;
+            ++stats.declarations;
+        }
+
+        for (size_t i = 0; i < config.functions; ++i) function_names.push_back(fresh_name("fn"));
+
+        for (size_t i = 0; i < config.functions; ++i) {
+            FunctionNode& func = out.add_function(int_type, function_names[i]);
+            func.params.reserve(config.params);
+            ++stats.nodes;
+            push_scope();
+            for (size_t p = 0; p < config.params; ++p) {
+                Symbol name = fresh_name("p");
+                func.params.emplace_back(int_type, name);
+                visible.push_back(name);
+                ++stats.nodes;
+                ++stats.declarations;
+            }
+            func.body = i < config.large_functions ? block(0, config.large_width) : block(0);
+            pop_scope();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef AST_HASH_H
+#define AST_HASH_H
+
+#include "parse_tree.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Structural hash of a subtree: node kinds, names, types, operators,
+// literal values and source locations in preorder, with empty child slots
+// marked. Names are hashed by text, so equal trees hash equally in every
+// process. Lines are hashed relative to an origin, the line of the unit
+// the subtree belongs to, the way cached diagnostics store them: a unit
+// that only moved as a whole keeps its hash, while any line change inside
+// it, which would change its diagnostics, changes the hash. Resolution
+// links are not part of the hash.
+class ASTHasher {
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    uint32_t origin = 0;
+    std::vector<const ASTNode*> work;
+    std::vector<const ASTNode*> children;
+    std::vector<uint64_t> text_hashes;   // by Symbol::id, 0 until looked up
+
+    void mix(uint64_t v) {
+        h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        h *= 0xff51afd7ed558ccdull;
+    }
+
+    // Text hashes live in the interner behind a lock; take each once.
+    void mix(Symbol s) {
+        if (s.id >= text_hashes.size()) text_hashes.resize(std::max<size_t>(s.id + 1, text_hashes.size() * 2), 0);
+        uint64_t& th = text_hashes[s.id];
+        if (!th) th = s.stable_hash() | 1;
+        mix(th);
+    }
+    void mix(const std::string& s) { mix(fnv1a(s.data(), s.size())); }
+
+    void mix_payload(const ASTNode* node) {
+        mix((uint64_t)node->kind() + 1);
+        // Unsigned wrap-around keeps lines before the origin distinct too.
+        uint32_t line = node->loc.known() ? node->loc.line - origin : 0;
+        mix(((uint64_t)line << 32) | node->loc.column);
+        switch (node->kind()) {
+            case NodeKind::Variable: {
+                auto var = static_cast<const VariableNode*>(node);
+                mix(var->type);
+                mix(var->name);
+                break;
+            }
+            case NodeKind::Block:
+                mix((uint64_t)static_cast<const BlockNode*>(node)->statements.size());
+                break;
+            case NodeKind::Call: {
+                auto call = static_cast<const CallNode*>(node);
+                mix(call->name);
+                mix((uint64_t)call->args.size());
+                break;
+            }
+            case NodeKind::Name:
+                mix(static_cast<const NameNode*>(node)->name);
+                break;
+            case NodeKind::Literal: {
+                auto lit = static_cast<const LiteralNode*>(node);
+                mix((uint64_t)lit->type);
+                mix(lit->text);
+                mix((uint64_t)lit->bits);
+                break;
+            }
+            case NodeKind::BinaryOp:
+                mix(static_cast<const BinaryOpNode*>(node)->op);
+                break;
+            case NodeKind::Assignment:
+                mix(static_cast<const AssignmentNode*>(node)->name);
+                break;
+            default:
+                break;
+        }
+    }
+
+public:
+    uint64_t value() const { return h; }
+
+    // Starts a new hash, keeping the buffers and cached text hashes. Lines
+    // are taken relative to `unit`'s; an unknown location hashes them as
+    // they are.
+    void reset(SourceLocation unit = SourceLocation()) {
+        h = 0x9e3779b97f4a7c15ull;
+        origin = unit.known() ? unit.line - 1 : 0;
+    }
+
+    void add(const ASTNode* root) {
+        work.clear();
+        work.push_back(root);
+        while (!work.empty()) {
+            const ASTNode* node = work.back();
+            work.pop_back();
+            if (!node) {
+                mix(uint64_t(0));
+                continue;
+            }
+            mix_payload(node);
+            children.clear();
+            for_each_child(node, [&](const ASTNode* child) { children.push_back(child); });
+            for (auto it = children.rbegin(); it != children.rend(); ++it) work.push_back(*it);
+        }
+    }
+
+    // Signature and body of a function; locations relative to the
+    // origin given to reset().
+    void add_function(const FunctionNode& func) {
+        mix(func.return_type);
+        mix(func.name);
+        mix((uint64_t)func.params.size());
+        for (auto& param : func.params) add(&param);
+        add(func.body);
+    }
+};
+
+// The free functions reuse one hasher per thread, and with it the text
+// hashes it has already looked up.
+inline ASTHasher& thread_hasher(SourceLocation unit) {
+    thread_local ASTHasher hasher;
+    hasher.reset(unit);
+    return hasher;
+}
+
+// Lines relative to the function's own.
+inline uint64_t hash_function(const FunctionNode& func) {
+    ASTHasher& hasher = thread_hasher(func.loc);
+    hasher.add_function(func);
+    return hasher.value();
+}
+
+// Lines relative to unit, e.g. the global an initializer belongs to.
+inline uint64_t hash_node(const ASTNode* node, SourceLocation unit = SourceLocation()) {
+    ASTHasher& hasher = thread_hasher(unit);
+    hasher.add(node);
+    return hasher.value();
+}
+
+#endif
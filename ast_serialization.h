@@ -0,0 +1,489 @@
+#ifndef AST_SERIALIZATION_H
+#define AST_SERIALIZATION_H
+
+#include "flat_ast.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk format of a FlatAST, designed to be used in place after mmap:
+//
+//   FlatFileHeader
+//   kinds[node_count]        uint8
+//   slots[node_count]        uint8
+//   names[node_count]        uint32
+//   types[node_count]        uint32
+//   ends[node_count]         uint32
+//   locs[node_count]         SourceLocation
+//   globals[global_count]    uint32
+//   functions[function_count] uint32
+//   string_offsets[symbol_count + 1] uint64, into string_data
+//   string_data[string_bytes]
+//
+// Every section starts on an 8-byte boundary. Integers are in the writer's
+// byte order; `byte_order` lets a reader reject files from a machine of
+// the other endianness. `checksum` covers everything after the header.
+// Bump kFlatFileVersion whenever the layout changes.
+static constexpr char kFlatFileMagic[8] = {'S', 'C', 'O', 'P', 'E', 'A', 'S', 'T'};
+static constexpr uint32_t kFlatFileVersion = 2;
+static constexpr uint32_t kFlatFileByteOrder = 0x01020304;
+
+struct FlatFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t node_count;
+    uint32_t global_count;
+    uint32_t function_count;
+    uint32_t symbol_count;
+    uint64_t string_bytes;
+    uint64_t payload_bytes;
+    uint64_t checksum;
+};
+
+namespace flat_file {
+
+inline uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+// Private name to write path's new contents to before renaming them into
+// place, unique per process and call so concurrent writers never share it.
+inline std::string temp_path(const std::string& path) {
+    static std::atomic<uint64_t> counter{0};
+    return path + ".tmp." + std::to_string((long)::getpid()) + "." + std::to_string(counter++);
+}
+
+// FNV-style hash over 8-byte words in four independent lanes, so that
+// verifying a large file runs at memory speed. size is a multiple of 8.
+inline uint64_t checksum(const char* data, uint64_t size) {
+    const uint64_t prime = 1099511628211ull;
+    uint64_t lane[4] = {14695981039346656037ull, 1, 2, 3};
+    uint64_t words = size / 8, i = 0;
+    for (; i + 4 <= words; i += 4) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t w;
+            std::memcpy(&w, data + (i + k) * 8, 8);
+            lane[k] = (lane[k] ^ w) * prime;
+        }
+    }
+    for (; i < words; ++i) {
+        uint64_t w;
+        std::memcpy(&w, data + i * 8, 8);
+        lane[0] = (lane[0] ^ w) * prime;
+    }
+    uint64_t h = size;
+    for (uint64_t l : lane) h = (h ^ l) * prime;
+    return h;
+}
+
+// Byte offsets of each section, relative to the end of the header.
+struct Layout {
+    uint64_t kinds, slots, names, types, ends, locs, globals, functions, offsets, strings, total;
+
+    Layout(const FlatFileHeader& h) {
+        uint64_t n = h.node_count;
+        kinds = 0;
+        slots = align8(kinds + n);
+        names = align8(slots + n);
+        types = align8(names + n * 4);
+        ends = align8(types + n * 4);
+        locs = align8(ends + n * 4);
+        globals = align8(locs + n * sizeof(SourceLocation));
+        functions = align8(globals + (uint64_t)h.global_count * 4);
+        offsets = align8(functions + (uint64_t)h.function_count * 4);
+        strings = align8(offsets + ((uint64_t)h.symbol_count + 1) * 8);
+        total = align8(strings + h.string_bytes);
+    }
+};
+
+// Number of optional child slots of kind; -1 for Block and Call, whose
+// children are not slotted.
+inline int slot_count(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Variable:
+        case NodeKind::Function:
+        case NodeKind::Assignment:
+        case NodeKind::Return: return 1;
+        case NodeKind::BinaryOp:
+        case NodeKind::While: return 2;
+        case NodeKind::If: return 3;
+        case NodeKind::For: return 4;
+        case NodeKind::Block:
+        case NodeKind::Call: return -1;
+        default: return 0;
+    }
+}
+
+// Checks that every index in v is in range and that the nodes form the
+// trees readers assume: globals then functions, each the root of a
+// preorder subtree, together covering all nodes; subtrees nested inside
+// their parents; exactly one child per present slot; parameters are
+// Variables. One linear pass. Returns null, or what is wrong.
+inline const char* check_structure(const FlatView& v) {
+    struct Open {
+        uint32_t index;
+        uint32_t children;
+    };
+    auto children_ok = [&](const Open& o) {
+        NodeKind kind = v.kind(o.index);
+        int slots = slot_count(kind);
+        if (slots < 0) return true;
+        if (kind == NodeKind::Literal) return o.children == 0;
+        unsigned bits = v.slots[o.index];
+        if (bits >> slots) return false;
+        if (kind == NodeKind::Function) return !bits || o.children > 0;
+        return o.children == (unsigned)__builtin_popcount(bits);
+    };
+
+    std::vector<Open> open;
+    uint32_t globals = 0, functions = 0;
+    for (uint32_t i = 0; i < v.node_count; ++i) {
+        while (!open.empty() && v.ends[open.back().index] <= i) {
+            if (!children_ok(open.back())) return "child count does not match the node's slots";
+            open.pop_back();
+        }
+        if (v.kinds[i] > (uint8_t)NodeKind::Program) return "bad node kind";
+        NodeKind kind = v.kind(i);
+        if (v.ends[i] <= i || v.ends[i] > v.node_count) return "subtree end out of range";
+        if (kind == NodeKind::Literal) {
+            if (v.slots[i] > (uint8_t)LiteralKind::Unknown) return "bad literal kind";
+            if (v.literal_has_text(i) && (v.names[i] >= v.symbol_count || v.types[i] >= v.symbol_count)) {
+                return "symbol index out of range";
+            }
+        } else if (v.names[i] >= v.symbol_count || v.types[i] >= v.symbol_count) {
+            return "symbol index out of range";
+        }
+
+        if (open.empty()) {
+            if (globals < v.global_count) {
+                if (v.globals[globals++] != i || kind != NodeKind::Variable) return "bad global index";
+            } else if (functions < v.function_count) {
+                if (v.functions[functions++] != i || kind != NodeKind::Function) return "bad function index";
+            } else {
+                return "node outside any global or function";
+            }
+        } else {
+            Open& parent = open.back();
+            uint32_t end = v.ends[parent.index];
+            if (v.ends[i] > end) return "subtree not nested in its parent";
+            if (kind == NodeKind::Function || kind == NodeKind::Program) return "misplaced function node";
+            if (v.kind(parent.index) == NodeKind::Function && kind != NodeKind::Variable
+                && !(v.has_slot(parent.index, 0) && v.ends[i] == end)) {
+                return "function parameter is not a variable";
+            }
+            ++parent.children;
+        }
+        open.push_back({i, 0});
+    }
+    while (!open.empty()) {
+        if (!children_ok(open.back())) return "child count does not match the node's slots";
+        open.pop_back();
+    }
+    if (globals != v.global_count || functions != v.function_count) return "bad global or function index";
+    return nullptr;
+}
+
+}
+
+// Writes ast to path. Returns false and sets *error on failure.
+inline bool write_flat_ast(const FlatAST& ast, const std::string& path, std::string* error = nullptr) {
+    FlatFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kFlatFileMagic, sizeof(h.magic));
+    h.version = kFlatFileVersion;
+    h.byte_order = kFlatFileByteOrder;
+    h.node_count = (uint32_t)ast.kinds.size();
+    h.global_count = (uint32_t)ast.globals.size();
+    h.function_count = (uint32_t)ast.functions.size();
+    h.symbol_count = (uint32_t)ast.symbols.size();
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(ast.symbols.size() + 1);
+    uint64_t string_bytes = 0;
+    for (Symbol s : ast.symbols) {
+        offsets.push_back(string_bytes);
+        string_bytes += s.str().size();
+    }
+    offsets.push_back(string_bytes);
+    h.string_bytes = string_bytes;
+
+    flat_file::Layout layout(h);
+    h.payload_bytes = layout.total;
+
+    std::vector<char> payload(layout.total, 0);
+    auto put = [&](uint64_t at, const void* data, size_t size) {
+        if (size) std::memcpy(payload.data() + at, data, size);
+    };
+    size_t n = ast.kinds.size();
+    put(layout.kinds, ast.kinds.data(), n);
+    put(layout.slots, ast.slots.data(), n);
+    put(layout.names, ast.names.data(), n * 4);
+    put(layout.types, ast.types.data(), n * 4);
+    put(layout.ends, ast.ends.data(), n * 4);
+    put(layout.locs, ast.locs.data(), n * sizeof(SourceLocation));
+    put(layout.globals, ast.globals.data(), ast.globals.size() * 4);
+    put(layout.functions, ast.functions.data(), ast.functions.size() * 4);
+    put(layout.offsets, offsets.data(), offsets.size() * 8);
+    for (size_t i = 0; i < ast.symbols.size(); ++i) {
+        const std::string& text = ast.symbols[i].str();
+        put(layout.strings + offsets[i], text.data(), text.size());
+    }
+    h.checksum = flat_file::checksum(payload.data(), payload.size());
+
+    std::string tmp = flat_file::temp_path(path);
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        if (error) *error = "cannot open " + tmp;
+        return false;
+    }
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1
+           && (payload.empty() || std::fwrite(payload.data(), payload.size(), 1, f) == 1);
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        if (error) *error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+// A FlatAST file mapped into memory. The node columns are used in place;
+// only the string table is read, to intern the program's names. The view
+// stays valid as long as this object is alive.
+class MappedFlatAST {
+    void* base = nullptr;
+    size_t size = 0;
+    std::vector<Symbol> symbols;
+    FlatView flat;
+
+    void unmap() {
+        if (base) munmap(base, size);
+        base = nullptr;
+        size = 0;
+    }
+
+    bool fail(std::string* error, const std::string& msg) {
+        if (error) *error = msg;
+        flat = FlatView();
+        unmap();
+        return false;
+    }
+
+public:
+    MappedFlatAST() = default;
+    MappedFlatAST(const MappedFlatAST&) = delete;
+    MappedFlatAST& operator=(const MappedFlatAST&) = delete;
+    ~MappedFlatAST() { unmap(); }
+
+    // Maps path and validates magic, version, byte order and sizes, then
+    // every index in the node columns (flat_file::check_structure), so a
+    // file that opens can be read without bounds checks. The checksum pass
+    // reads the whole file; skipping it only skips corruption detection.
+    bool open(const std::string& path, std::string* error = nullptr, bool verify_checksum = true) {
+        unmap();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return fail(error, "cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return fail(error, "cannot stat " + path);
+        }
+        size = (size_t)st.st_size;
+        if (size < sizeof(FlatFileHeader)) {
+            ::close(fd);
+            return fail(error, path + ": file too small");
+        }
+        base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            return fail(error, "cannot map " + path);
+        }
+
+        const FlatFileHeader& h = *static_cast<const FlatFileHeader*>(base);
+        if (std::memcmp(h.magic, kFlatFileMagic, sizeof(h.magic)) != 0) return fail(error, path + ": not a flat AST file");
+        if (h.byte_order != kFlatFileByteOrder) return fail(error, path + ": written on a machine of other byte order");
+        if (h.version != kFlatFileVersion) {
+            return fail(error, path + ": unsupported version " + std::to_string(h.version));
+        }
+        flat_file::Layout layout(h);
+        if (h.payload_bytes != layout.total || sizeof(FlatFileHeader) + layout.total > size) {
+            return fail(error, path + ": truncated or inconsistent sizes");
+        }
+        const char* payload = static_cast<const char*>(base) + sizeof(FlatFileHeader);
+        if (verify_checksum && flat_file::checksum(payload, layout.total) != h.checksum) {
+            return fail(error, path + ": checksum mismatch");
+        }
+
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(payload + layout.offsets);
+        const char* strings = payload + layout.strings;
+        symbols.clear();
+        symbols.reserve(h.symbol_count);
+        for (uint32_t i = 0; i < h.symbol_count; ++i) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > h.string_bytes) return fail(error, path + ": bad string table");
+            symbols.push_back(Symbol(std::string_view(strings + offsets[i], offsets[i + 1] - offsets[i])));
+        }
+
+        flat = FlatView();
+        flat.node_count = h.node_count;
+        flat.kinds = reinterpret_cast<const uint8_t*>(payload + layout.kinds);
+        flat.slots = reinterpret_cast<const uint8_t*>(payload + layout.slots);
+        flat.names = reinterpret_cast<const uint32_t*>(payload + layout.names);
+        flat.types = reinterpret_cast<const uint32_t*>(payload + layout.types);
+        flat.ends = reinterpret_cast<const uint32_t*>(payload + layout.ends);
+        flat.locs = reinterpret_cast<const SourceLocation*>(payload + layout.locs);
+        flat.global_count = h.global_count;
+        flat.globals = reinterpret_cast<const uint32_t*>(payload + layout.globals);
+        flat.function_count = h.function_count;
+        flat.functions = reinterpret_cast<const uint32_t*>(payload + layout.functions);
+        flat.symbol_count = (uint32_t)symbols.size();
+        flat.symbols = symbols.data();
+        if (const char* problem = flat_file::check_structure(flat)) return fail(error, path + ": " + problem);
+        return true;
+    }
+
+    const FlatView& view() const { return flat; }
+    size_t mapped_bytes() const { return size; }
+};
+
+// Rebuilds node trees from a flat program, for consumers that need
+// ASTNode pointers (type checking, incremental analysis). Nodes are
+// allocated in the target program's arena.
+class Inflater {
+    const FlatView& ast;
+    ProgramNode& program;
+    struct Open {
+        uint32_t end;
+        uint32_t index;
+        ASTNode* node;
+        unsigned next_slot;
+    };
+    std::vector<Open> open;
+
+    ASTNode* make_node(uint32_t i) {
+        ASTNode* node;
+        switch (ast.kind(i)) {
+            case NodeKind::Variable: node = program.make<VariableNode>(ast.type(i), ast.name(i)); break;
+            case NodeKind::Block: node = program.make<BlockNode>(); break;
+            case NodeKind::Call: node = program.make<CallNode>(ast.name(i)); break;
+            case NodeKind::Name: node = program.make<NameNode>(ast.name(i)); break;
+            case NodeKind::Literal:
+                node = program.make<LiteralNode>(ast.literal_kind(i), ast.literal_has_text(i) ? ast.name(i) : Symbol(), ast.literal_bits(i));
+                break;
+            case NodeKind::BinaryOp: node = program.make<BinaryOpNode>(ast.name(i).str()); break;
+            case NodeKind::Assignment: node = program.make<AssignmentNode>(ast.name(i)); break;
+            case NodeKind::Return: node = program.make<ReturnNode>(); break;
+            case NodeKind::If: node = program.make<IfNode>(); break;
+            case NodeKind::While: node = program.make<WhileNode>(); break;
+            case NodeKind::For: node = program.make<ForNode>(); break;
+            default: return nullptr;
+        }
+        node->loc = ast.locs[i];
+        return node;
+    }
+
+    static ASTNode** slot(ASTNode* node, unsigned k) {
+        switch (node->kind()) {
+            case NodeKind::Variable: return &static_cast<VariableNode*>(node)->value;
+            case NodeKind::BinaryOp: {
+                auto binary = static_cast<BinaryOpNode*>(node);
+                return k == 0 ? &binary->left : &binary->right;
+            }
+            case NodeKind::Assignment: return &static_cast<AssignmentNode*>(node)->value;
+            case NodeKind::Return: return &static_cast<ReturnNode*>(node)->value;
+            case NodeKind::If: {
+                auto if_stmt = static_cast<IfNode*>(node);
+                return k == 0 ? &if_stmt->condition : k == 1 ? &if_stmt->then_branch : &if_stmt->else_branch;
+            }
+            case NodeKind::While: {
+                auto while_stmt = static_cast<WhileNode*>(node);
+                return k == 0 ? &while_stmt->condition : &while_stmt->body;
+            }
+            case NodeKind::For: {
+                auto for_stmt = static_cast<ForNode*>(node);
+                return k == 0 ? &for_stmt->initializer : k == 1 ? &for_stmt->condition
+                     : k == 2 ? &for_stmt->increment : &for_stmt->body;
+            }
+            default: return nullptr;
+        }
+    }
+
+    void attach(Open& parent, ASTNode* child) {
+        switch (parent.node->kind()) {
+            case NodeKind::Block: static_cast<BlockNode*>(parent.node)->statements.push_back(child); return;
+            case NodeKind::Call: static_cast<CallNode*>(parent.node)->args.push_back(child); return;
+            default: break;
+        }
+        while (!ast.has_slot(parent.index, parent.next_slot)) ++parent.next_slot;
+        *slot(parent.node, parent.next_slot++) = child;
+    }
+
+    // Fills in the descendants of flat node root, whose own node exists.
+    void subtree(uint32_t root, ASTNode* root_node) {
+        open.clear();
+        open.push_back({ast.ends[root], root, root_node, 0});
+        for (uint32_t i = root + 1; i < ast.ends[root]; ++i) {
+            while (open.back().end <= i) open.pop_back();
+            ASTNode* node = make_node(i);
+            attach(open.back(), node);
+            if (ast.ends[i] > i + 1) open.push_back({ast.ends[i], i, node, 0});
+        }
+    }
+
+public:
+    Inflater(const FlatView& view, ProgramNode& out) : ast(view), program(out) {}
+
+    void inflate() {
+        program.reserve(program.functions.size() + ast.function_count, program.globals.size() + ast.global_count);
+        for (uint32_t g = 0; g < ast.global_count; ++g) {
+            uint32_t i = ast.globals[g];
+            program.globals.emplace_back(ast.type(i), ast.name(i));
+            program.globals.back().loc = ast.locs[i];
+            subtree(i, &program.globals.back());
+        }
+        for (uint32_t f = 0; f < ast.function_count; ++f) {
+            uint32_t i = ast.functions[f];
+            program.functions.emplace_back(ast.type(i), ast.name(i));
+            FunctionNode& func = program.functions.back();
+            func.loc = ast.locs[i];
+            bool has_body = ast.has_slot(i, 0);
+            for (uint32_t c = i + 1; c < ast.ends[i]; c = ast.ends[c]) {
+                if (has_body && ast.ends[c] == ast.ends[i]) {
+                    func.body = make_node(c);
+                    subtree(c, func.body);
+                } else {
+                    func.params.emplace_back(ast.type(c), ast.name(c));
+                    func.params.back().loc = ast.locs[c];
+                    subtree(c, &func.params.back());
+                }
+            }
+        }
+    }
+};
+
+// Appends the globals and functions of a flat program to program.
+inline void inflate(const FlatView& ast, ProgramNode& program) {
+    Inflater(ast, program).inflate();
+}
+
+// Reads a file written by write_flat_ast into program. Returns false and
+// sets *error on failure.
+inline bool read_program(const std::string& path, ProgramNode& program, std::string* error = nullptr) {
+    MappedFlatAST mapped;
+    if (!mapped.open(path, error)) return false;
+    inflate(mapped.view(), program);
+    return true;
+}
+
+// Flattens program and writes it to path.
+inline bool write_program(const ProgramNode& program, const std::string& path, std::string* error = nullptr) {
+    return write_flat_ast(flatten(program), path, error);
+}
+
+#endif
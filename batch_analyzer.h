@@ -0,0 +1,197 @@
+#ifndef BATCH_ANALYZER_H
+#define BATCH_ANALYZER_H
+
+#include "link_index.h"
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+// Diagnostics of one program of a batch.
+struct UnitResult {
+    std::vector<Diagnostic> errors;
+    std::vector<TypeDiagnostic> type_errors;
+    // Indices into `errors` of the UndefinedFunction errors; link() may
+    // resolve them against other units.
+    std::vector<uint32_t> unresolved_calls;
+
+    bool passed() const { return errors.empty() && type_errors.empty(); }
+};
+
+// Checks many programs against one shared prelude of library
+// declarations. The prelude is declared once and only read afterwards;
+// each worker thread keeps one ScopeAnalyzer layered on top of it and
+// reuses it for every program it takes from the queue, so per-program
+// setup is limited to declaring that program's own globals.
+class BatchAnalyzer {
+    AnalyzerOptions options;
+    Scope prelude;
+    std::vector<Diagnostic> prelude_errors;
+    std::vector<UnitResult> results;
+    std::atomic<bool> verdict_failed{false};   // verdict_only: some unit failed
+
+    // Points the calls of program that result reported as undefined, and
+    // that definitions knows, at their definition. Returns whether any
+    // call was linked.
+    static bool resolve_calls(ProgramNode& program, const UnitResult& result,
+                              const std::unordered_map<Symbol, const FunctionNode*>& definitions) {
+        std::unordered_map<Symbol, const FunctionNode*> linked_names;
+        for (uint32_t e : result.unresolved_calls) {
+            Symbol name = result.errors[e].name;
+            auto it = definitions.find(name);
+            if (it != definitions.end()) linked_names.emplace(name, it->second);
+        }
+        if (linked_names.empty()) return false;
+        bool linked = false;
+        std::vector<ASTNode*> work;
+        auto visit = [&](ASTNode* root) {
+            work.push_back(root);
+            while (!work.empty()) {
+                ASTNode* node = work.back();
+                work.pop_back();
+                if (!node) continue;
+                if (node->kind() == NodeKind::Call) {
+                    auto call = static_cast<CallNode*>(node);
+                    auto it = call->callee ? linked_names.end() : linked_names.find(call->name);
+                    if (it != linked_names.end()) {
+                        call->callee = it->second;
+                        linked = true;
+                    }
+                }
+                for_each_child(node, [&](const ASTNode* child) { work.push_back(const_cast<ASTNode*>(child)); });
+            }
+        };
+        for (auto& func : program.functions) visit(func.body);
+        for (auto& var : program.globals) visit(var.value);
+        return linked;
+    }
+
+    // Type-checks program again, in the order ScopeAnalyzer does, and
+    // keeps what the unit's error limit still allows.
+    void retype(ProgramNode& program, UnitResult& result) const {
+        TypeChecker types;
+        for (auto& func : program.functions) types.check_function(&func);
+        for (auto& var : program.globals) {
+            if (var.value) types.check_global(&var);
+        }
+        size_t limit = options.error_limit();
+        if (limit) types.errors.resize(std::min(types.errors.size(), limit - std::min(limit, result.errors.size())));
+        result.type_errors.swap(types.errors);
+    }
+
+public:
+    // options.threads is the number of programs checked concurrently; each
+    // program is checked on a single thread.
+    explicit BatchAnalyzer(const AnalyzerOptions& opts = AnalyzerOptions()) : options(opts) {}
+
+    // Declares the globals and functions of library in the prelude.
+    // Initializers and bodies are not checked. Call before check(); library
+    // must stay alive while results are in use.
+    void add_prelude(ProgramNode* library) {
+        declare_globals(library, prelude, prelude_errors);
+    }
+
+    // Checks every unit; results[i] belongs to units[i]. Error limits in
+    // the options apply to each unit. With stop_at_first_error or
+    // verdict_only, units not yet started when some unit fails are
+    // skipped: the verdict is exact, but which failing units report
+    // depends on scheduling.
+    bool check(const std::vector<ProgramNode*>& units) {
+        results.clear();
+        results.resize(units.size());
+
+        AnalyzerOptions unit_options = options;
+        unit_options.threads = 1;
+        unsigned workers = resolve_thread_count(options.threads);
+        std::vector<ScopeAnalyzer> analyzers(workers, ScopeAnalyzer(prelude, unit_options));
+        bool stop_on_failure = options.stop_at_first_error || options.verdict_only;
+        std::atomic<bool> cancelled{false};
+        verdict_failed = false;
+
+        parallel_for(units.size(), workers, [&](unsigned worker, size_t i) {
+            if (cancelled.load(std::memory_order_relaxed)) return;
+            ScopeAnalyzer& analyzer = analyzers[worker];
+            if (!analyzer.check(units[i])) {
+                if (options.verdict_only) verdict_failed = true;
+                if (stop_on_failure) cancelled.store(true, std::memory_order_relaxed);
+            }
+            UnitResult& result = results[i];
+            result.errors = analyzer.takeErrors();
+            result.type_errors = analyzer.takeTypeErrors();
+            for (size_t e = 0; e < result.errors.size(); ++e) {
+                if (result.errors[e].kind == ScopeError::UndefinedFunction) result.unresolved_calls.push_back((uint32_t)e);
+            }
+            analyzer.reset();
+        });
+        return passed();
+    }
+
+    // Link pass: indexes the functions of every unit and drops the
+    // UndefinedFunction errors of calls that another unit defines. One
+    // binary search per unresolved call, after all units are checked.
+    // With check_types, the linked calls are also pointed at their
+    // definitions and their units type-checked again, so argument and
+    // return types are checked against the linked signatures.
+    bool link(const std::vector<ProgramNode*>& units) {
+        LinkIndex index;
+        for (size_t i = 0; i < units.size(); ++i) index.add_unit((uint32_t)i, *units[i]);
+        index.finish();
+        if (options.check_types && !options.verdict_only) {
+            // Lowest unit first, as in the index.
+            std::unordered_map<Symbol, const FunctionNode*> definitions;
+            for (ProgramNode* unit : units) {
+                for (auto& func : unit->functions) definitions.emplace(func.name, &func);
+            }
+            parallel_for(results.size(), resolve_thread_count(options.threads), [&](unsigned, size_t i) {
+                if (results[i].unresolved_calls.empty()) return;
+                if (resolve_calls(*units[i], results[i], definitions)) retype(*units[i], results[i]);
+            });
+        }
+        return link(index);
+    }
+
+    // Same, against a prebuilt index, e.g. one mapped from the files of
+    // other shards of the build. The index holds no signatures, so linked
+    // calls are not type-checked; unresolved calls cause no type errors
+    // in the first place. Has nothing to work on after a verdict_only
+    // check, which keeps no diagnostics.
+    bool link(const LinkIndex& index) {
+        parallel_for(results.size(), resolve_thread_count(options.threads), [&](unsigned, size_t i) {
+            UnitResult& result = results[i];
+            if (result.unresolved_calls.empty()) return;
+            std::vector<Diagnostic> kept;
+            kept.reserve(result.errors.size());
+            size_t next = 0;
+            for (size_t e = 0; e < result.errors.size(); ++e) {
+                bool unresolved = next < result.unresolved_calls.size() && result.unresolved_calls[next] == e;
+                if (unresolved) ++next;
+                if (unresolved && index.find(result.errors[e].name)) continue;
+                kept.push_back(result.errors[e]);
+            }
+            result.errors.swap(kept);
+            result.unresolved_calls.clear();
+        });
+        return passed();
+    }
+
+    const Scope& getPrelude() const { return prelude; }
+    const std::vector<Diagnostic>& getPreludeErrors() const { return prelude_errors; }
+    const std::vector<UnitResult>& getResults() const { return results; }
+
+    bool passed() const {
+        if (!prelude_errors.empty() || verdict_failed) return false;
+        for (auto& result : results) {
+            if (!result.passed()) return false;
+        }
+        return true;
+    }
+
+    size_t errorCount() const {
+        size_t count = prelude_errors.size();
+        for (auto& result : results) count += result.errors.size();
+        return count;
+    }
+};
+
+#endif
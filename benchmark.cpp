@@ -0,0 +1,313 @@
+// Throughput benchmark for ScopeAnalyzer::check on synthetic programs.
+//
+//   g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+//   ./benchmark --functions=20000 --depth=5 --width=8 --reuse=0.5 --threads=1
+//
+// Every option of GeneratorConfig can be set as --name=value; --iterations
+// repeats the analysis on the same program and reports the best run.
+// Boolean options can be given alone (--flat) or as --flat=0 / --flat=1.
+// --flat --dump=PATH writes the flat program to PATH and analyzes the
+// mmap'd file instead of the in-memory copy. --flat checks scopes only and
+// cannot be combined with --check-types.
+//
+// Built with -DSCOPE_ANALYZER_STATS=1 it also prints the analyzer's
+// counters, and --trace=PATH writes the phases as a Chrome trace.
+// --mem-report prints where the program's and the analyzer's memory
+// goes, by node kind. --verdict-only runs the VerdictAnalyzer, which is
+// compiled without diagnostics.
+//
+// --stress=1 runs the stress suite of stress_programs.h instead: every
+// shape is checked at full size and at 1/8 of it, compared against the
+// ReferenceChecker, and fails (exit status 1) if the diagnostics or
+// resolution links differ or if time or scope memory per node grows by
+// more than 4x from the small to the full size. --stress-scale scales the
+// sizes, e.g. for sanitizer builds:
+//
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread benchmark.cpp -o stress
+//   ./stress --stress=1 --stress-scale=0.25 --iterations=1
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread benchmark.cpp -o stress
+//   ./stress --stress=1 --stress-scale=0.25 --iterations=1 --threads=4
+#include "ast_generator.h"
+#include "ast_serialization.h"
+#include "flat_analyzer.h"
+#include "memory_report.h"
+#include "scope_analyzer.h"
+#include "stress_programs.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+
+namespace {
+
+struct BenchOptions {
+    GeneratorConfig generator;
+    AnalyzerOptions analyzer;
+    size_t iterations = 5;
+    bool flat = false;      // analyze the struct-of-arrays layout instead
+    std::string dump;       // with flat: round-trip through this file
+    std::string trace;      // Chrome trace of the last iteration
+    bool mem_report = false;
+    bool stress = false;
+    double stress_scale = 1;
+};
+
+bool parse_option(const char* arg, const char* name, std::string& value) {
+    size_t len = std::strlen(name);
+    if (std::strncmp(arg, "--", 2) != 0 || std::strncmp(arg + 2, name, len) != 0 || arg[2 + len] != '=') {
+        return false;
+    }
+    value = arg + 3 + len;
+    return true;
+}
+
+// A boolean option: --name alone means --name=1.
+bool parse_flag(const char* arg, const char* name, std::string& value) {
+    if (std::strncmp(arg, "--", 2) == 0 && std::strcmp(arg + 2, name) == 0) {
+        value = "1";
+        return true;
+    }
+    return parse_option(arg, name, value);
+}
+
+bool parse_args(int argc, char** argv, BenchOptions& opts) {
+    GeneratorConfig& g = opts.generator;
+    for (int i = 1; i < argc; ++i) {
+        std::string v;
+        if (parse_option(argv[i], "functions", v)) g.functions = std::stoul(v);
+        else if (parse_option(argv[i], "globals", v)) g.globals = std::stoul(v);
+        else if (parse_option(argv[i], "params", v)) g.params = std::stoul(v);
+        else if (parse_option(argv[i], "depth", v)) g.depth = std::stoul(v);
+        else if (parse_option(argv[i], "width", v)) g.width = std::stoul(v);
+        else if (parse_option(argv[i], "large-functions", v)) g.large_functions = std::stoul(v);
+        else if (parse_option(argv[i], "large-width", v)) g.large_width = std::stoul(v);
+        else if (parse_option(argv[i], "expr-terms", v)) g.expr_terms = std::stoul(v);
+        else if (parse_option(argv[i], "reuse", v)) g.reuse = std::stod(v);
+        else if (parse_option(argv[i], "error-rate", v)) g.error_rate = std::stod(v);
+        else if (parse_option(argv[i], "seed", v)) g.seed = std::stoull(v);
+        else if (parse_option(argv[i], "threads", v)) opts.analyzer.threads = (unsigned)std::stoul(v);
+        else if (parse_flag(argv[i], "check-types", v)) opts.analyzer.check_types = v != "0";
+        else if (parse_option(argv[i], "max-errors", v)) opts.analyzer.max_errors = std::stoul(v);
+        else if (parse_flag(argv[i], "stop-at-first-error", v)) opts.analyzer.stop_at_first_error = v != "0";
+        else if (parse_flag(argv[i], "verdict-only", v)) opts.analyzer.verdict_only = v != "0";
+        else if (parse_flag(argv[i], "flat", v)) opts.flat = v != "0";
+        else if (parse_option(argv[i], "dump", v)) opts.dump = v;
+        else if (parse_option(argv[i], "trace", v)) opts.trace = v;
+        else if (parse_flag(argv[i], "mem-report", v)) opts.mem_report = v != "0";
+        else if (parse_flag(argv[i], "stress", v)) opts.stress = v != "0";
+        else if (parse_option(argv[i], "stress-scale", v)) opts.stress_scale = std::stod(v);
+        else if (parse_option(argv[i], "iterations", v)) opts.iterations = std::stoul(v);
+        else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    if (opts.flat && opts.analyzer.check_types) {
+        std::cerr << "--check-types is not supported with --flat" << std::endl;
+        return false;
+    }
+    if (opts.iterations == 0) opts.iterations = 1;
+    return true;
+}
+
+// Peak resident set size of the process in KiB.
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void print_stats(const AnalyzerStats& stats) {
+    for (size_t p = 0; p < AnalyzerStats::kPhases; ++p) {
+        std::cout << "phase " << analyzer_phase_name((AnalyzerPhase)p) << ": "
+                  << stats.phase_seconds[p] * 1e3 << " ms\n";
+    }
+    for (size_t k = 0; k < AnalyzerStats::kKinds; ++k) {
+        if (stats.nodes[k]) std::cout << "  " << node_kind_name((NodeKind)k) << ": " << stats.nodes[k] << "\n";
+    }
+    std::cout << "scopes entered: " << stats.scopes_entered << "\n"
+              << "peak depth:     " << stats.peak_scope_depth << "\n"
+              << "global lookups: " << stats.global_lookups << " (average chain "
+              << stats.average_chain_depth() << ")" << std::endl;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct StressRun {
+    size_t nodes = 0;
+    double seconds = 0;     // best check time
+    size_t scope_bytes = 0; // global scope and walkers
+    bool correct = false;
+};
+
+bool same_diagnostics(const std::vector<Diagnostic>& a, const std::vector<Diagnostic>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].kind != b[i].kind || a[i].name != b[i].name || a[i].loc.line != b[i].loc.line
+            || a[i].loc.column != b[i].loc.column) {
+            return false;
+        }
+    }
+    return true;
+}
+
+StressRun run_stress(StressShape shape, size_t size, const BenchOptions& opts) {
+    // The reference reports every error, so no limits here.
+    AnalyzerOptions options;
+    options.threads = opts.analyzer.threads;
+    options.check_types = opts.analyzer.check_types;
+
+    StressRun run;
+    ProgramNode program;
+    run.nodes = StressBuilder().build(shape, size, program);
+    std::vector<Diagnostic> errors;
+    for (size_t i = 0; i < opts.iterations; ++i) {
+        ScopeAnalyzer analyzer(options);
+        auto start = std::chrono::steady_clock::now();
+        analyzer.check(&program);
+        double elapsed = seconds_since(start);
+        if (i == 0 || elapsed < run.seconds) run.seconds = elapsed;
+        const AnalyzerMemory& memory = analyzer.getMemory();
+        run.scope_bytes = memory.global_scope_bytes + memory.walker_bytes;
+        errors = analyzer.takeErrors();
+    }
+
+    ReferenceChecker reference;
+    reference.check(program);
+    run.correct = reference.wrong_links == 0 && same_diagnostics(errors, reference.errors);
+    return run;
+}
+
+int run_stress_suite(const BenchOptions& opts) {
+    struct Case {
+        StressShape shape;
+        size_t size;
+    };
+    const Case cases[] = {
+        {StressShape::DeepBlocks, 10000},
+        {StressShape::LongChain, 1000000},
+        {StressShape::ManyLocals, 100000},
+        {StressShape::Shadowing, 100000},
+    };
+    const size_t kRatio = 8;
+    const double kMaxGrowth = 4;
+
+    bool ok = true;
+    for (const Case& c : cases) {
+        size_t size = std::max(kRatio, (size_t)(c.size * opts.stress_scale));
+        StressRun small = run_stress(c.shape, size / kRatio, opts);
+        StressRun large = run_stress(c.shape, size, opts);
+        double scale = (double)large.nodes / small.nodes;
+        double time_growth = large.seconds / small.seconds / scale;
+        double memory_growth = (double)large.scope_bytes / small.scope_bytes / scale;
+        bool linear = time_growth <= kMaxGrowth && memory_growth <= kMaxGrowth;
+        bool passed = small.correct && large.correct && linear;
+        ok = ok && passed;
+        std::cout << stress_shape_name(c.shape) << ": " << size << " (" << large.nodes << " nodes) "
+                  << large.seconds * 1e3 << " ms, per-node growth time " << time_growth
+                  << " memory " << memory_growth << ", "
+                  << (!small.correct || !large.correct ? "WRONG RESULT" : linear ? "ok" : "NOT LINEAR") << std::endl;
+    }
+    std::cout << (ok ? "stress: passed" : "stress: FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opts;
+    if (!parse_args(argc, argv, opts)) return 2;
+    if (opts.stress) return run_stress_suite(opts);
+
+    ProgramNode program;
+    ASTGenerator generator(opts.generator);
+    auto gen_start = std::chrono::steady_clock::now();
+    generator.generate(program);
+    double gen_time = seconds_since(gen_start);
+    const GeneratorStats& stats = generator.getStats();
+
+    FlatAST flat;
+    if (opts.flat) {
+        auto flat_start = std::chrono::steady_clock::now();
+        flat = flatten(program);
+        std::cout << "flatten time:   " << seconds_since(flat_start) * 1e3 << " ms\n"
+                  << "flat bytes/node: " << (double)flat.memory_bytes() / flat.kinds.size() << "\n";
+    }
+    FlatView view = flat.view();
+    MappedFlatAST mapped;
+    if (opts.flat && !opts.dump.empty()) {
+        std::string error;
+        auto write_start = std::chrono::steady_clock::now();
+        if (!write_flat_ast(flat, opts.dump, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        double write_time = seconds_since(write_start);
+        auto map_start = std::chrono::steady_clock::now();
+        if (!mapped.open(opts.dump, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::cout << "write time:     " << write_time * 1e3 << " ms\n"
+                  << "map time:       " << seconds_since(map_start) * 1e3 << " ms ("
+                  << mapped.mapped_bytes() << " bytes)\n";
+        flat = FlatAST();
+        view = mapped.view();
+    }
+
+    double best = 0;
+    size_t error_count = 0;
+    AnalyzerStats analyzer_stats;
+    AnalyzerMemory analyzer_memory;
+    for (size_t i = 0; i < opts.iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (opts.flat) {
+            FlatScopeAnalyzer analyzer(opts.analyzer);
+            analyzer.check(view);
+            error_count = analyzer.errorCount();
+        } else if (opts.analyzer.verdict_only) {
+            VerdictAnalyzer analyzer(opts.analyzer);
+            analyzer.check(&program);
+            error_count = !analyzer.passed();
+            analyzer_stats = analyzer.getStats();
+            analyzer_memory = analyzer.getMemory();
+        } else {
+            ScopeAnalyzer analyzer(opts.analyzer);
+            analyzer.check(&program);
+            error_count = analyzer.errorCount() + analyzer.getTypeErrors().size();
+            analyzer_stats = analyzer.getStats();
+            analyzer_memory = analyzer.getMemory();
+        }
+        double elapsed = seconds_since(start);
+        if (i == 0 || elapsed < best) best = elapsed;
+    }
+
+    std::cout << "nodes:          " << stats.nodes << "\n"
+              << "lookups:        " << stats.lookups << "\n"
+              << "declarations:   " << stats.declarations << "\n"
+              << "errors:         " << error_count << "\n"
+              << "generate time:  " << gen_time * 1e3 << " ms\n"
+              << "check time:     " << best * 1e3 << " ms (best of " << opts.iterations << ")\n"
+              << "nodes/sec:      " << (double)stats.nodes / best << "\n"
+              << "lookups/sec:    " << (double)stats.lookups / best << "\n"
+              << "symbol search:  " << symbol_search::kernel_name() << "\n"
+              << "peak RSS:       " << peak_rss_kb() << " KiB" << std::endl;
+    if (AnalyzerStats::enabled && !opts.flat) print_stats(analyzer_stats);
+    if (opts.mem_report && opts.flat) {
+        std::cout << "flat memory:    " << (double)(mapped.mapped_bytes() ? mapped.mapped_bytes() : flat.memory_bytes()) / 1024 << " KiB\n";
+    } else if (opts.mem_report) {
+        MemoryReport report = measure_memory(program);
+        report.analyzer = analyzer_memory;
+        print_memory_report(std::cout, report);
+    }
+    if (!opts.trace.empty()) {
+        std::ofstream trace(opts.trace);
+        write_chrome_trace(trace, analyzer_stats);
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "parse_tree.h"
+#include "type_checker.h"
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class ScopeError {
+    UndeclaredVariable,
+    UndefinedFunction,
+    VariableRedefined,
+    FunctionRedefined
+};
+
+// One finding of the analyzer. Recording a diagnostic copies three small
+// values; turning it into text is left to the reporter below.
+struct Diagnostic {
+    ScopeError kind;
+    Symbol name;
+    SourceLocation loc;
+};
+
+inline const char* error_kind_name(ScopeError err) {
+    switch (err) {
+        case ScopeError::UndeclaredVariable: return "UndeclaredVariable";
+        case ScopeError::UndefinedFunction: return "UndefinedFunction";
+        case ScopeError::VariableRedefined: return "VariableRedefined";
+        case ScopeError::FunctionRedefined: return "FunctionRedefined";
+    }
+    return "Unknown";
+}
+
+inline const char* error_message_prefix(ScopeError err) {
+    switch (err) {
+        case ScopeError::UndefinedFunction: return "Undefined function: ";
+        case ScopeError::UndeclaredVariable: return "Undeclared variable: ";
+        case ScopeError::VariableRedefined: return "Variable redefined: ";
+        case ScopeError::FunctionRedefined: return "Function redefined: ";
+    }
+    return "";
+}
+
+enum class DiagnosticFormat {
+    Text,
+    Json
+};
+
+class DiagnosticReporter {
+    DiagnosticFormat format;
+
+    static void append_location(std::string& out, SourceLocation loc) {
+        out += std::to_string(loc.line);
+        out += ':';
+        out += std::to_string(loc.column);
+    }
+
+    static void append_json_string(std::string& out, const std::string& text) {
+        out += '"';
+        for (char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if ((unsigned char)c < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+                        out += buf;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    static void append_text(std::string& out, const Diagnostic& d) {
+        if (d.loc.known()) {
+            append_location(out, d.loc);
+            out += ": ";
+        }
+        out += "Error: ";
+        out += error_message_prefix(d.kind);
+        out += d.name.str();
+        out += '\n';
+    }
+
+    static void append_text(std::string& out, const TypeDiagnostic& d) {
+        if (d.loc.known()) {
+            append_location(out, d.loc);
+            out += ": ";
+        }
+        out += "Type error: ";
+        out += type_error_message(d);
+        out += '\n';
+    }
+
+    static void append_json(std::string& out, const TypeDiagnostic& d) {
+        out += "{\"kind\":\"";
+        out += type_error_name(d.kind);
+        out += "\",\"name\":";
+        append_json_string(out, d.name.str());
+        out += ",\"expected\":\"";
+        out += basic_type_name(d.expected);
+        out += "\",\"actual\":\"";
+        out += basic_type_name(d.actual);
+        out += "\",\"line\":";
+        out += std::to_string(d.loc.line);
+        out += ",\"column\":";
+        out += std::to_string(d.loc.column);
+        out += '}';
+    }
+
+    static void append_json(std::string& out, const Diagnostic& d) {
+        out += "{\"kind\":\"";
+        out += error_kind_name(d.kind);
+        out += "\",\"name\":";
+        append_json_string(out, d.name.str());
+        out += ",\"line\":";
+        out += std::to_string(d.loc.line);
+        out += ",\"column\":";
+        out += std::to_string(d.loc.column);
+        out += '}';
+    }
+
+public:
+    explicit DiagnosticReporter(DiagnosticFormat f = DiagnosticFormat::Text) : format(f) {}
+
+    // JSON string literal of text, for embedding reports in larger
+    // documents.
+    static std::string json_string(const std::string& text) {
+        std::string out;
+        append_json_string(out, text);
+        return out;
+    }
+
+    // Formats the whole batch into one buffer. Works for scope
+    // (Diagnostic) and type (TypeDiagnostic) findings alike.
+    template<typename D>
+    std::string format_all(const std::vector<D>& diagnostics) const {
+        std::string out;
+        out.reserve(diagnostics.size() * 48);
+        if (format == DiagnosticFormat::Json) {
+            out += '[';
+            for (size_t i = 0; i < diagnostics.size(); ++i) {
+                if (i) out += ',';
+                append_json(out, diagnostics[i]);
+            }
+            out += "]\n";
+        } else {
+            for (auto& d : diagnostics) append_text(out, d);
+        }
+        return out;
+    }
+
+    // Writes the batch with a single stream write and one flush.
+    template<typename D>
+    void report(std::ostream& os, const std::vector<D>& diagnostics) const {
+        std::string out = format_all(diagnostics);
+        os.write(out.data(), (std::streamsize)out.size());
+        os.flush();
+    }
+};
+
+#endif
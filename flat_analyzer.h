@@ -0,0 +1,192 @@
+#ifndef FLAT_ANALYZER_H
+#define FLAT_ANALYZER_H
+
+#include "flat_ast.h"
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <vector>
+
+// ScopeWalker for the flat layout: one linear sweep over a subtree's node
+// range. Scopes and deferred assignment checks are closed when the sweep
+// reaches the end of the node that opened them, which gives the same
+// check order, and the same diagnostics, as the tree walker.
+class FlatScopeWalker {
+public:
+    std::vector<Diagnostic> errors;
+
+    FlatScopeWalker(const FlatView& view, const Scope& g, Scope* initializer_scope = nullptr)
+        : ast(view), global(g), global_decls(initializer_scope) {}
+
+    void check_function(uint32_t func) {
+        locals.push();
+        bool has_body = ast.has_slot(func, 0);
+        for (uint32_t c = func + 1; c < ast.ends[func]; c = ast.ends[c]) {
+            if (has_body && ast.ends[c] == ast.ends[func]) {
+                check_range(c, ast.ends[c]);
+            } else if (!locals.add(ast.name(c), ast.type(c))) {
+                error(ScopeError::VariableRedefined, c);
+            }
+        }
+        locals.pop();
+    }
+
+    void check_range(uint32_t begin, uint32_t end) {
+        closes.clear();
+        for (uint32_t i = begin; i < end; ++i) {
+            close_until(i);
+            visit(i);
+        }
+        close_until(end);
+    }
+
+private:
+    static constexpr uint32_t kLeaveScope = UINT32_MAX;
+    struct Close {
+        uint32_t end;
+        uint32_t node;   // assignment to resolve, or kLeaveScope
+    };
+
+    const FlatView& ast;
+    const Scope& global;
+    Scope* global_decls;
+    ScopeStack locals;
+    std::vector<Close> closes;
+
+    void error(ScopeError err, uint32_t i) { errors.push_back({err, ast.name(i), ast.locs[i]}); }
+
+    bool resolves(Symbol name) const {
+        return locals.resolve(name) || global.resolve(name);
+    }
+
+    void close_until(uint32_t i) {
+        while (!closes.empty() && closes.back().end <= i) {
+            uint32_t node = closes.back().node;
+            closes.pop_back();
+            if (node == kLeaveScope) {
+                locals.pop();
+            } else if (!resolves(ast.name(node))) {
+                error(ScopeError::UndeclaredVariable, node);
+            }
+        }
+    }
+
+    void visit(uint32_t i) {
+        switch (ast.kind(i)) {
+            case NodeKind::Block:
+            case NodeKind::For:
+                locals.push();
+                closes.push_back({ast.ends[i], kLeaveScope});
+                break;
+            case NodeKind::Variable: {
+                Symbol name = ast.name(i);
+                bool exists = locals.empty() ? global_decls->in_scope(name) : locals.in_scope(name);
+                if (exists) {
+                    error(ScopeError::VariableRedefined, i);
+                } else if (locals.empty()) {
+                    global_decls->add(name, ast.type(i));
+                } else {
+                    locals.add(name, ast.type(i));
+                }
+                break;
+            }
+            case NodeKind::Call:
+                if (!global.find_function(ast.name(i))) error(ScopeError::UndefinedFunction, i);
+                break;
+            case NodeKind::Name:
+                if (!resolves(ast.name(i))) error(ScopeError::UndeclaredVariable, i);
+                break;
+            case NodeKind::Assignment:
+                // Resolved once its value subtree has been swept.
+                closes.push_back({ast.ends[i], i});
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+// ScopeAnalyzer over a FlatView. Produces the same diagnostics as
+// ScopeAnalyzer on the program the view was built from, including under
+// max_errors, stop_at_first_error and verdict_only; resolution links are
+// not recorded since there are no nodes to store them on. There is no
+// type checker for the flat layout, so check_types must be false.
+class FlatScopeAnalyzer {
+    AnalyzerOptions options;
+    std::vector<Diagnostic> errors;
+    Scope global;
+    size_t limit = 0;
+    bool failed = false;
+
+    bool limit_reached() const { return limit && errors.size() >= limit; }
+
+    // Appends one unit's diagnostics up to the limit.
+    void take(const std::vector<Diagnostic>& unit) {
+        size_t n = limit ? std::min(unit.size(), limit - std::min(limit, errors.size())) : unit.size();
+        errors.insert(errors.end(), unit.begin(), unit.begin() + n);
+    }
+
+public:
+    explicit FlatScopeAnalyzer(const AnalyzerOptions& opts = AnalyzerOptions()) : options(opts) {}
+
+    // With an error limit, analysis ends once the limit is reached. With
+    // more than one thread every body is still swept and the diagnostics
+    // past the limit are dropped, so the result is that of one thread.
+    bool check(const FlatView& ast) {
+        limit = options.error_limit();
+        // PHASE 1: Global declarations
+        for (uint32_t g = 0; g < ast.global_count; ++g) {
+            uint32_t i = ast.globals[g];
+            if (!global.add(ast.name(i), ast.type(i))) {
+                errors.push_back({ScopeError::VariableRedefined, ast.name(i), ast.locs[i]});
+            }
+        }
+        for (uint32_t f = 0; f < ast.function_count; ++f) {
+            uint32_t i = ast.functions[f];
+            if (!global.add_function(ast.name(i), ast.type(i))) {
+                errors.push_back({ScopeError::FunctionRedefined, ast.name(i), ast.locs[i]});
+            }
+        }
+        if (limit_reached()) errors.resize(limit);
+
+        // PHASE 2: Function bodies
+        unsigned workers = resolve_thread_count(options.threads);
+        if (!limit_reached() && workers > 1) {
+            std::vector<FlatScopeWalker> walkers(workers, FlatScopeWalker(ast, global));
+            std::vector<std::vector<Diagnostic>> results(ast.function_count);
+            parallel_for(ast.function_count, workers, [&](unsigned worker, size_t f) {
+                walkers[worker].check_function(ast.functions[f]);
+                results[f].swap(walkers[worker].errors);
+            });
+            for (auto& result : results) take(result);
+        } else if (!limit_reached()) {
+            FlatScopeWalker walker(ast, global);
+            for (uint32_t f = 0; f < ast.function_count && !limit_reached(); ++f) {
+                walker.check_function(ast.functions[f]);
+                take(walker.errors);
+                walker.errors.clear();
+            }
+        }
+
+        // PHASE 3: Global initializers
+        FlatScopeWalker walker(ast, global, &global);
+        for (uint32_t g = 0; g < ast.global_count && !limit_reached(); ++g) {
+            uint32_t i = ast.globals[g];
+            if (!ast.has_slot(i, 0)) continue;
+            walker.check_range(i + 1, ast.ends[i + 1]);
+            take(walker.errors);
+            walker.errors.clear();
+        }
+
+        if (options.verdict_only) {
+            failed = !errors.empty();
+            errors.clear();
+        }
+        return passed();
+    }
+
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+    bool passed() const { return !failed && errors.empty(); }
+    size_t errorCount() const { return errors.size(); }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include "parse_tree.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Read-only view of a preorder-linearized program in struct-of-arrays
+// form. Node i's subtree is [i, ends[i]); its first child, if any, is
+// i + 1 and each next sibling starts at the previous sibling's end.
+//
+// Columns per node:
+//   kinds  NodeKind
+//   slots  bit k set if optional child slot k is present (see below)
+//   names  name of Variable/Function/Call/Name/Assignment, operator of
+//          BinaryOp, text of String and Unknown Literal
+//   types  type of Variable, return type of Function
+//   ends   one past the last node of the subtree
+//   locs   source location, only read when reporting
+// names and types are indices into `symbols`, the program's own table of
+// interned strings (index 0 is the empty string), so the arrays do not
+// depend on the ids of the process that built them.
+//
+// Child slots, in order: Variable value; Function body (after its
+// parameter Variables); BinaryOp left, right; Assignment value; Return
+// value; If condition, then, else; While condition, body; For
+// initializer, condition, increment, body. Block and Call children are
+// their statements/arguments and have no slot bits. A Literal, which has
+// no children either, keeps its LiteralKind in `slots`; unless it has
+// text, `names` and `types` hold the low and high half of its bits.
+struct FlatView {
+    uint32_t node_count = 0;
+    const uint8_t* kinds = nullptr;
+    const uint8_t* slots = nullptr;
+    const uint32_t* names = nullptr;
+    const uint32_t* types = nullptr;
+    const uint32_t* ends = nullptr;
+    const SourceLocation* locs = nullptr;
+
+    uint32_t global_count = 0;
+    const uint32_t* globals = nullptr;      // node index of each global Variable
+    uint32_t function_count = 0;
+    const uint32_t* functions = nullptr;    // node index of each Function
+
+    uint32_t symbol_count = 0;
+    const Symbol* symbols = nullptr;
+
+    NodeKind kind(uint32_t i) const { return (NodeKind)kinds[i]; }
+    Symbol name(uint32_t i) const { return symbols[names[i]]; }
+    Symbol type(uint32_t i) const { return symbols[types[i]]; }
+    bool has_slot(uint32_t i, unsigned slot) const { return (slots[i] >> slot) & 1; }
+
+    LiteralKind literal_kind(uint32_t i) const { return (LiteralKind)slots[i]; }
+    bool literal_has_text(uint32_t i) const {
+        return literal_kind(i) == LiteralKind::String || literal_kind(i) == LiteralKind::Unknown;
+    }
+    int64_t literal_bits(uint32_t i) const {
+        return literal_has_text(i) ? 0 : (int64_t)(((uint64_t)types[i] << 32) | names[i]);
+    }
+};
+
+// Owning flat program, built from a ProgramNode by flatten().
+class FlatAST {
+public:
+    std::vector<uint8_t> kinds;
+    std::vector<uint8_t> slots;
+    std::vector<uint32_t> names;
+    std::vector<uint32_t> types;
+    std::vector<uint32_t> ends;
+    std::vector<SourceLocation> locs;
+    std::vector<uint32_t> globals;
+    std::vector<uint32_t> functions;
+    std::vector<Symbol> symbols;
+
+    FlatView view() const {
+        FlatView v;
+        v.node_count = (uint32_t)kinds.size();
+        v.kinds = kinds.data();
+        v.slots = slots.data();
+        v.names = names.data();
+        v.types = types.data();
+        v.ends = ends.data();
+        v.locs = locs.data();
+        v.global_count = (uint32_t)globals.size();
+        v.globals = globals.data();
+        v.function_count = (uint32_t)functions.size();
+        v.functions = functions.data();
+        v.symbol_count = (uint32_t)symbols.size();
+        v.symbols = symbols.data();
+        return v;
+    }
+
+    void shrink_to_fit() {
+        kinds.shrink_to_fit();
+        slots.shrink_to_fit();
+        names.shrink_to_fit();
+        types.shrink_to_fit();
+        ends.shrink_to_fit();
+        locs.shrink_to_fit();
+        globals.shrink_to_fit();
+        functions.shrink_to_fit();
+        symbols.shrink_to_fit();
+    }
+
+    size_t memory_bytes() const {
+        return kinds.capacity() + slots.capacity()
+             + (names.capacity() + types.capacity() + ends.capacity()) * sizeof(uint32_t)
+             + locs.capacity() * sizeof(SourceLocation)
+             + (globals.capacity() + functions.capacity()) * sizeof(uint32_t)
+             + symbols.capacity() * sizeof(Symbol);
+    }
+};
+
+// Linearizes program in preorder. Iterative, so tree depth is unbounded.
+class Flattener {
+    FlatAST out;
+    std::vector<uint32_t> local_ids;   // indexed by Symbol::id; kOpen if unassigned
+    struct Pending {
+        const ASTNode* node;
+        uint32_t close;   // node index to close, or kOpen to visit `node`
+    };
+    static constexpr uint32_t kOpen = UINT32_MAX;
+    std::vector<Pending> work;
+    std::vector<const ASTNode*> children;
+
+    uint32_t local(Symbol s) {
+        if (s.id >= local_ids.size()) local_ids.resize(std::max<size_t>(s.id + 1, local_ids.size() * 2), kOpen);
+        uint32_t& id = local_ids[s.id];
+        if (id == kOpen) {
+            id = (uint32_t)out.symbols.size();
+            out.symbols.push_back(s);
+        }
+        return id;
+    }
+
+    uint32_t append(const ASTNode* node, uint8_t slots, Symbol name, Symbol type) {
+        uint32_t index = (uint32_t)out.kinds.size();
+        out.kinds.push_back((uint8_t)node->kind());
+        out.slots.push_back(slots);
+        out.names.push_back(local(name));
+        out.types.push_back(local(type));
+        out.ends.push_back(0);
+        out.locs.push_back(node->loc);
+        return index;
+    }
+
+    uint32_t append_node(const ASTNode* node) {
+        uint8_t slots = 0;
+        unsigned slot = 0;
+        for_each_child(node, [&](const ASTNode* child) {
+            if (child) slots |= (uint8_t)(1u << slot);
+            ++slot;
+        });
+        switch (node->kind()) {
+            case NodeKind::Variable: {
+                auto var = static_cast<const VariableNode*>(node);
+                return append(node, slots, var->name, var->type);
+            }
+            case NodeKind::Call:
+                return append(node, 0, static_cast<const CallNode*>(node)->name, Symbol());
+            case NodeKind::Block:
+                return append(node, 0, Symbol(), Symbol());
+            case NodeKind::Name:
+                return append(node, 0, static_cast<const NameNode*>(node)->name, Symbol());
+            case NodeKind::Literal: {
+                auto lit = static_cast<const LiteralNode*>(node);
+                uint32_t index = append(node, (uint8_t)lit->type, lit->text, Symbol());
+                if (lit->type != LiteralKind::String && lit->type != LiteralKind::Unknown) {
+                    out.names[index] = (uint32_t)(uint64_t)lit->bits;
+                    out.types[index] = (uint32_t)((uint64_t)lit->bits >> 32);
+                }
+                return index;
+            }
+            case NodeKind::BinaryOp:
+                return append(node, slots, Symbol(static_cast<const BinaryOpNode*>(node)->op), Symbol());
+            case NodeKind::Assignment:
+                return append(node, slots, static_cast<const AssignmentNode*>(node)->name, Symbol());
+            default:
+                return append(node, slots, Symbol(), Symbol());
+        }
+    }
+
+    void add_subtree(const ASTNode* root) {
+        work.push_back({root, kOpen});
+        while (!work.empty()) {
+            Pending p = work.back();
+            work.pop_back();
+            if (p.close != kOpen) {
+                out.ends[p.close] = (uint32_t)out.kinds.size();
+                continue;
+            }
+            uint32_t index = append_node(p.node);
+            work.push_back({nullptr, index});
+            children.clear();
+            for_each_child(p.node, [&](const ASTNode* child) {
+                if (child) children.push_back(child);
+            });
+            for (auto it = children.rbegin(); it != children.rend(); ++it) work.push_back({*it, kOpen});
+        }
+    }
+
+public:
+    FlatAST flatten(const ProgramNode& program) {
+        out = FlatAST();
+        local_ids.clear();
+        local(Symbol());
+
+        for (auto& var : program.globals) {
+            out.globals.push_back((uint32_t)out.kinds.size());
+            add_subtree(&var);
+        }
+        for (auto& func : program.functions) {
+            uint32_t index = (uint32_t)out.kinds.size();
+            out.functions.push_back(index);
+            append(&func, func.body ? 1 : 0, func.name, func.return_type);
+            for (auto& param : func.params) add_subtree(&param);
+            if (func.body) add_subtree(func.body);
+            out.ends[index] = (uint32_t)out.kinds.size();
+        }
+        out.shrink_to_fit();
+        return std::move(out);
+    }
+};
+
+inline FlatAST flatten(const ProgramNode& program) {
+    return Flattener().flatten(program);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef FUNCTION_TABLE_H
+#define FUNCTION_TABLE_H
+
+#include "parse_tree.h"
+#include "symbol.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Declared signature of a function, returned by value from
+// FunctionTable::find. param_types points into the table that declares
+// the function and stays valid until that table is modified.
+struct FunctionSignature {
+    const FunctionNode* decl = nullptr;
+    Symbol return_type;
+    uint32_t param_count = 0;
+    const Symbol* param_types = nullptr;
+    bool found = false;
+
+    explicit operator bool() const { return found; }
+};
+
+// Function namespace of a program, kept apart from the global variables
+// as in type-checker.py. Signatures are stored flat, parameter types of
+// all functions in one array, and indexed by an open-addressing table on
+// the dense Symbol ids, so most lookups are a single probe. Like Scope,
+// a table can be layered on a parent (the prelude's) that it shadows.
+class FunctionTable {
+    struct Entry {
+        Symbol name;
+        Symbol return_type;
+        const FunctionNode* decl;
+        uint32_t first_param;
+        uint32_t param_count;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Symbol> param_types;
+    std::vector<uint32_t> slots;   // entry index + 1, 0 when empty
+    uint32_t mask = 0;
+
+    static uint32_t hash(Symbol name) { return name.id * 0x9e3779b1u; }
+
+    int32_t lookup(Symbol name) const {
+        if (slots.empty()) return -1;
+        for (uint32_t i = hash(name) & mask;; i = (i + 1) & mask) {
+            uint32_t slot = slots[i];
+            if (!slot) return -1;
+            if (entries[slot - 1].name == name) return (int32_t)slot - 1;
+        }
+    }
+
+    void insert_slot(uint32_t index) {
+        uint32_t i = hash(entries[index].name) & mask;
+        while (slots[i]) i = (i + 1) & mask;
+        slots[i] = index + 1;
+    }
+
+    // Keeps the load factor at or below one half.
+    void grow(size_t functions) {
+        size_t capacity = slots.empty() ? 16 : slots.size();
+        while (capacity < functions * 2) capacity *= 2;
+        if (capacity == slots.size()) return;
+        slots.assign(capacity, 0);
+        mask = (uint32_t)capacity - 1;
+        for (uint32_t i = 0; i < entries.size(); ++i) insert_slot(i);
+    }
+
+    FunctionSignature signature(const Entry& e) const {
+        FunctionSignature s;
+        s.decl = e.decl;
+        s.return_type = e.return_type;
+        s.param_count = e.param_count;
+        s.param_types = param_types.data() + e.first_param;
+        s.found = true;
+        return s;
+    }
+
+public:
+    const FunctionTable* parent;
+
+    FunctionTable(const FunctionTable* p = nullptr) : parent(p) {}
+
+    void reserve(size_t functions, size_t params = 0) {
+        entries.reserve(functions);
+        param_types.reserve(params);
+        grow(functions);
+    }
+
+    // Declares func; fails if a function of that name is already declared
+    // in this table. func must outlive the table's use.
+    bool add(const FunctionNode& func) {
+        if (lookup(func.name) >= 0) return false;
+        grow(entries.size() + 1);
+        entries.push_back({func.name, func.return_type, &func, (uint32_t)param_types.size(), (uint32_t)func.params.size()});
+        for (auto& param : func.params) param_types.push_back(param.type);
+        insert_slot((uint32_t)entries.size() - 1);
+        return true;
+    }
+
+    // Declares a function known only by name and return type.
+    bool add(Symbol name, Symbol return_type) {
+        if (lookup(name) >= 0) return false;
+        grow(entries.size() + 1);
+        entries.push_back({name, return_type, nullptr, (uint32_t)param_types.size(), 0});
+        insert_slot((uint32_t)entries.size() - 1);
+        return true;
+    }
+
+    bool in_table(Symbol name) const { return lookup(name) >= 0; }
+
+    // Signature of name in this table only.
+    FunctionSignature find_local(Symbol name) const {
+        int32_t i = lookup(name);
+        return i >= 0 ? signature(entries[i]) : FunctionSignature();
+    }
+
+    // Nearest declaration of name along the parent chain.
+    FunctionSignature find(Symbol name) const {
+        for (const FunctionTable* t = this; t; t = t->parent) {
+            int32_t i = t->lookup(name);
+            if (i >= 0) return t->signature(t->entries[i]);
+        }
+        return FunctionSignature();
+    }
+
+    size_t size() const { return entries.size(); }
+
+    // Heap bytes held by the table.
+    size_t memory_bytes() const {
+        return entries.capacity() * sizeof(Entry) + (param_types.capacity() + slots.capacity()) * sizeof(uint32_t);
+    }
+
+    // Calls f(name, signature) for every function of this table.
+    template<typename F>
+    void for_each(F&& f) const {
+        for (auto& e : entries) f(e.name, signature(e));
+    }
+
+    // Removes all functions, keeping the storage.
+    void clear() {
+        entries.clear();
+        param_types.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+    }
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef INCREMENTAL_ANALYZER_H
+#define INCREMENTAL_ANALYZER_H
+
+#include "ast_hash.h"
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// What the client edited since the previous run.
+struct ProgramEdit {
+    std::vector<const FunctionNode*> functions;   // signature or body changed
+    std::vector<const VariableNode*> globals;     // initializer changed
+};
+
+// Scope analysis that keeps per-function results between runs and only
+// re-checks what an edit can affect:
+//   - functions and initializers listed in the edit whose structural hash
+//     changed, and any that are new or were moved in memory;
+//   - a unit found at the address of a cached one that is not the same
+//     unit: another name, or other body or parameter storage. That is
+//     what erasing from the program's vectors leaves behind;
+//   - when the set of global bindings changed (a global or function was
+//     added, removed, renamed or moved), the units that looked up one of
+//     the affected names.
+// Declarations (phase 1) are redone on every update since they are cheap
+// and define the global environment every cached result depends on.
+//
+// Cached diagnostics store line numbers relative to their function, so a
+// function that only moved down the file reports updated locations; the
+// structural hash covers locations the same way, so a move inside an
+// edited unit re-checks it.
+// Resolution links (NameNode::decl etc.) of units that are not re-checked
+// stay valid: any change to what they point at re-checks the unit.
+class IncrementalAnalyzer {
+    struct UnitResult {
+        uint64_t hash = 0;
+        uint64_t generation = 0;
+        // Identity of the unit the result was computed for.
+        Symbol name;
+        const void* root = nullptr;
+        const void* params = nullptr;
+        std::vector<Symbol> global_refs;   // sorted, unique
+        std::vector<Diagnostic> errors;    // lines relative to the unit
+    };
+
+    std::unordered_map<const FunctionNode*, UnitResult> function_results;
+    std::unordered_map<const VariableNode*, UnitResult> initializer_results;
+    std::unordered_map<Symbol, Binding> previous_globals;
+    std::unordered_map<Symbol, const FunctionNode*> previous_functions;
+    std::vector<Diagnostic> errors;
+    std::vector<Symbol> refs;
+    uint64_t generation = 0;
+    size_t rechecked = 0;
+
+    static bool same_binding(const Binding& a, const Binding& b) {
+        return a.type == b.type && a.decl == b.decl;
+    }
+
+    static bool same_unit(const UnitResult& result, const FunctionNode& func) {
+        return result.name == func.name && result.root == func.body && result.params == func.params.data();
+    }
+
+    static bool same_unit(const UnitResult& result, const VariableNode& var) {
+        return result.name == var.name && result.root == var.value;
+    }
+
+    static bool depends_on(const UnitResult& result, const std::unordered_set<Symbol>& names) {
+        for (Symbol s : result.global_refs) {
+            if (names.count(s)) return true;
+        }
+        return false;
+    }
+
+    // Cached lines are stored relative to the unit's own line. Unsigned
+    // wrap-around makes the round trip exact even for earlier lines.
+    static void make_relative(std::vector<Diagnostic>& diags, SourceLocation origin) {
+        if (!origin.known()) return;
+        for (auto& d : diags) {
+            if (d.loc.known()) d.loc.line = d.loc.line - origin.line + 1;
+        }
+    }
+
+    void recheck(ScopeWalker& walker, UnitResult& result, SourceLocation origin) {
+        ++rechecked;
+        std::sort(refs.begin(), refs.end());
+        refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+        result.global_refs = refs;
+        result.errors.swap(walker.errors);
+        walker.errors.clear();
+        make_relative(result.errors, origin);
+        refs.clear();
+    }
+
+    void append(const UnitResult& result, SourceLocation origin) {
+        for (Diagnostic d : result.errors) {
+            if (origin.known() && d.loc.known()) d.loc.line = d.loc.line + origin.line - 1;
+            errors.push_back(d);
+        }
+    }
+
+    // Names whose global binding, as a variable or as a function, differs
+    // from the previous run.
+    std::unordered_set<Symbol> changed_globals(const Scope& global) {
+        std::unordered_set<Symbol> changed;
+        std::unordered_map<Symbol, Binding> current;
+        current.reserve(global.size());
+        global.for_each([&](Symbol name, const Binding& binding) {
+            auto it = previous_globals.find(name);
+            if (it == previous_globals.end() || !same_binding(it->second, binding)) changed.insert(name);
+            current.emplace(name, binding);
+        });
+        for (auto& entry : previous_globals) {
+            if (!global.in_scope(entry.first)) changed.insert(entry.first);
+        }
+        previous_globals.swap(current);
+
+        std::unordered_map<Symbol, const FunctionNode*> current_functions;
+        current_functions.reserve(global.functions().size());
+        global.functions().for_each([&](Symbol name, const FunctionSignature& func) {
+            auto it = previous_functions.find(name);
+            if (it == previous_functions.end() || it->second != func.decl) changed.insert(name);
+            current_functions.emplace(name, func.decl);
+        });
+        for (auto& entry : previous_functions) {
+            if (!global.functions().in_table(entry.first)) changed.insert(entry.first);
+        }
+        previous_functions.swap(current_functions);
+        return changed;
+    }
+
+    template<typename Node>
+    static void evict_stale(std::unordered_map<const Node*, UnitResult>& results, uint64_t current) {
+        for (auto it = results.begin(); it != results.end();) {
+            if (it->second.generation != current) it = results.erase(it);
+            else ++it;
+        }
+    }
+
+public:
+    // Analyzes the whole program from scratch and seeds the cache.
+    bool check(ProgramNode* program) {
+        function_results.clear();
+        initializer_results.clear();
+        previous_globals.clear();
+        previous_functions.clear();
+        return update(program, ProgramEdit());
+    }
+
+    // Re-analyzes program after `edit`. Units not mentioned in the edit
+    // are assumed unchanged unless they are new to the analyzer.
+    bool update(ProgramNode* program, const ProgramEdit& edit) {
+        ++generation;
+        rechecked = 0;
+        errors.clear();
+
+        // PHASE 1: Global declarations
+        Scope global;
+        declare_globals(program, global, errors);
+        std::unordered_set<Symbol> changed = changed_globals(global);
+        std::unordered_set<const void*> edited(edit.functions.begin(), edit.functions.end());
+        edited.insert(edit.globals.begin(), edit.globals.end());
+
+        // PHASE 2: Function bodies
+        ScopeWalker walker(global);
+        walker.track_global_refs(&refs);
+        for (auto& func : program->functions) {
+            auto found = function_results.find(&func);
+            bool dirty = found == function_results.end() || !same_unit(found->second, func);
+            UnitResult& result = function_results[&func];
+            uint64_t hash = result.hash;
+            if (dirty || edited.count(&func)) {
+                hash = hash_function(func);
+                dirty |= hash != result.hash;
+            }
+            if (!dirty && !changed.empty()) dirty = depends_on(result, changed);
+            if (dirty) {
+                walker.check_function(&func);
+                recheck(walker, result, func.loc);
+                result.hash = hash;
+                result.name = func.name;
+                result.root = func.body;
+                result.params = func.params.data();
+            }
+            result.generation = generation;
+            append(result, func.loc);
+        }
+
+        // PHASE 3: Global initializers
+        ScopeWalker init_walker(global, &global);
+        init_walker.track_global_refs(&refs);
+        for (auto& var : program->globals) {
+            if (!var.value) continue;
+            auto found = initializer_results.find(&var);
+            bool dirty = found == initializer_results.end() || !same_unit(found->second, var);
+            UnitResult& result = initializer_results[&var];
+            uint64_t hash = result.hash;
+            if (dirty || edited.count(&var)) {
+                hash = hash_node(var.value, var.loc);
+                dirty |= hash != result.hash;
+            }
+            if (!dirty && !changed.empty()) dirty = depends_on(result, changed);
+            if (dirty) {
+                init_walker.check_node(var.value);
+                recheck(init_walker, result, var.loc);
+                result.hash = hash;
+                result.name = var.name;
+                result.root = var.value;
+            }
+            result.generation = generation;
+            append(result, var.loc);
+        }
+
+        evict_stale(function_results, generation);
+        evict_stale(initializer_results, generation);
+        return errors.empty();
+    }
+
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+    bool passed() const { return errors.empty(); }
+    size_t errorCount() const { return errors.size(); }
+    // Functions and initializers actually re-checked by the last run.
+    size_t recheckedCount() const { return rechecked; }
+};
+
+#endif
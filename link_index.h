@@ -0,0 +1,181 @@
+#ifndef LINK_INDEX_H
+#define LINK_INDEX_H
+
+#include "ast_serialization.h"
+#include "parse_tree.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// One function definition known to the linker.
+struct LinkEntry {
+    uint64_t hash;   // fnv1a of the name, see Symbol::stable_hash()
+    uint32_t unit;   // index of the defining program in its batch
+    uint32_t name;   // offset of the NUL-terminated name in the text block
+};
+
+// Sorted index of the functions defined by every unit of a build. Built in
+// memory with add_unit()/finish(), or mapped from a file written by
+// write(), so separately analyzed shards can link against each other.
+// Lookups are a binary search on the name hash, confirmed by comparing
+// the text; a name defined by several units resolves to the lowest unit.
+class LinkIndex {
+    std::vector<LinkEntry> owned_entries;
+    std::string owned_text;
+    const LinkEntry* entries = nullptr;
+    size_t entry_count = 0;
+    const char* text = nullptr;
+    size_t text_size = 0;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t entry_count;
+        uint64_t text_bytes;
+        uint64_t checksum;
+    };
+    static constexpr char kMagic[8] = {'S', 'C', 'O', 'P', 'E', 'L', 'N', 'K'};
+    static constexpr uint32_t kVersion = 1;
+
+    void unmap() {
+        if (mapping) munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+
+    void use_owned() {
+        entries = owned_entries.data();
+        entry_count = owned_entries.size();
+        text = owned_text.data();
+        text_size = owned_text.size();
+    }
+
+    bool fail(std::string* error, const std::string& msg) {
+        if (error) *error = msg;
+        unmap();
+        use_owned();
+        return false;
+    }
+
+public:
+    LinkIndex() = default;
+    LinkIndex(const LinkIndex&) = delete;
+    LinkIndex& operator=(const LinkIndex&) = delete;
+    ~LinkIndex() { unmap(); }
+
+    void add_unit(uint32_t unit, const ProgramNode& program) {
+        for (auto& func : program.functions) {
+            const std::string& name = func.name.str();
+            owned_entries.push_back({func.name.stable_hash(), unit, (uint32_t)owned_text.size()});
+            owned_text.append(name.data(), name.size() + 1);
+        }
+    }
+
+    // Sorts the entries added so far; call once before looking up.
+    void finish() {
+        std::stable_sort(owned_entries.begin(), owned_entries.end(), [](const LinkEntry& a, const LinkEntry& b) {
+            return a.hash != b.hash ? a.hash < b.hash : a.unit < b.unit;
+        });
+        use_owned();
+    }
+
+    // Definition of name, or null.
+    const LinkEntry* find(Symbol name) const {
+        uint64_t hash = name.stable_hash();
+        const LinkEntry* it = std::lower_bound(entries, entries + entry_count, hash,
+            [](const LinkEntry& e, uint64_t h) { return e.hash < h; });
+        const std::string& wanted = name.str();
+        for (; it != entries + entry_count && it->hash == hash; ++it) {
+            if (wanted == text + it->name) return it;
+        }
+        return nullptr;
+    }
+
+    size_t size() const { return entry_count; }
+
+    bool write(const std::string& path, std::string* error = nullptr) const {
+        FileHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, kMagic, sizeof(h.magic));
+        h.version = kVersion;
+        h.byte_order = kFlatFileByteOrder;
+        h.entry_count = entry_count;
+        h.text_bytes = text_size;
+        std::vector<char> payload(flat_file::align8(entry_count * sizeof(LinkEntry) + text_size), 0);
+        if (entry_count) std::memcpy(payload.data(), entries, entry_count * sizeof(LinkEntry));
+        if (text_size) std::memcpy(payload.data() + entry_count * sizeof(LinkEntry), text, text_size);
+        h.checksum = flat_file::checksum(payload.data(), payload.size());
+
+        std::string tmp = flat_file::temp_path(path);
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) {
+            if (error) *error = "cannot open " + tmp;
+            return false;
+        }
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1
+               && (payload.empty() || std::fwrite(payload.data(), payload.size(), 1, f) == 1);
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            if (error) *error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    // Maps an index file in place of the in-memory entries. Every name
+    // offset is checked against the name table, so lookups on a file that
+    // opens stay inside the mapping.
+    bool open(const std::string& path, std::string* error = nullptr) {
+        unmap();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return fail(error, "cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHeader)) {
+            ::close(fd);
+            return fail(error, path + ": not a link index");
+        }
+        mapping_size = (size_t)st.st_size;
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            return fail(error, "cannot map " + path);
+        }
+
+        const FileHeader& h = *static_cast<const FileHeader*>(mapping);
+        if (std::memcmp(h.magic, kMagic, sizeof(h.magic)) != 0 || h.byte_order != kFlatFileByteOrder) {
+            return fail(error, path + ": not a link index");
+        }
+        if (h.version != kVersion) return fail(error, path + ": unsupported version " + std::to_string(h.version));
+        if (h.entry_count > mapping_size / sizeof(LinkEntry) || h.text_bytes > mapping_size) {
+            return fail(error, path + ": truncated");
+        }
+        uint64_t payload_bytes = flat_file::align8(h.entry_count * sizeof(LinkEntry) + h.text_bytes);
+        if (sizeof(FileHeader) + payload_bytes > mapping_size) return fail(error, path + ": truncated");
+        const char* payload = static_cast<const char*>(mapping) + sizeof(FileHeader);
+        if (flat_file::checksum(payload, payload_bytes) != h.checksum) return fail(error, path + ": checksum mismatch");
+        if (h.text_bytes && payload[h.entry_count * sizeof(LinkEntry) + h.text_bytes - 1] != '\0') {
+            return fail(error, path + ": bad name table");
+        }
+        const LinkEntry* mapped = reinterpret_cast<const LinkEntry*>(payload);
+        for (uint64_t i = 0; i < h.entry_count; ++i) {
+            if (mapped[i].name >= h.text_bytes) return fail(error, path + ": name offset out of range");
+            if (i && mapped[i].hash < mapped[i - 1].hash) return fail(error, path + ": entries not sorted");
+        }
+
+        entries = mapped;
+        entry_count = h.entry_count;
+        text = payload + h.entry_count * sizeof(LinkEntry);
+        text_size = h.text_bytes;
+        return true;
+    }
+};
+
+#endif
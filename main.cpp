@@ -1,7 +1,26 @@
+// Scope analysis of a hand-written program covering every error kind.
+//
+//   g++ -std=c++17 -O2 -pthread main.cpp -o main
+//   ./main --mem-report
+//
+// --mem-report also prints where the program's and the analyzer's memory
+// goes, by node kind (see memory_report.h).
+#include "memory_report.h"
 #include "scope_analyzer.h"
+#include <cstring>
 #include <iostream>
 
-int main() {
+int main(int argc, char** argv) {
+    bool mem_report = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--mem-report") == 0 || std::strcmp(argv[i], "--mem-report=1") == 0) {
+            mem_report = true;
+        } else if (std::strcmp(argv[i], "--mem-report=0") != 0) {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+
     std::cout << "=== COMPLETE SCOPE ANALYSIS TEST WITH ALL CASES ===" << std::endl;
     
     ProgramNode program;
@@ -15,12 +34,12 @@ int main() {
     // Code: int MAX_SIZE = 100;
     std::cout << "✓ Adding: int MAX_SIZE = 100;" << std::endl;
     program.globals.emplace_back("int", "MAX_SIZE");
-    program.globals.back().value = std::make_unique<LiteralNode>("int", "100");
+    program.globals.back().value = program.make<LiteralNode>("int", "100");
     
     // Code: float PI = 3.14;
     std::cout << "✓ Adding: float PI = 3.14;" << std::endl;
     program.globals.emplace_back("float", "PI");
-    program.globals.back().value = std::make_unique<LiteralNode>("float", "3.14");
+    program.globals.back().value = program.make<LiteralNode>("float", "3.14");
     
     // Code: int calculate(int a, int b) { return a * b; }
     std::cout << "✓ Adding: int calculate(int a, int b) { return a * b; }" << std::endl;
@@ -29,46 +48,46 @@ int main() {
     calculate_func.params.emplace_back("int", "a");
     calculate_func.params.emplace_back("int", "b");
     
-    auto calculate_body = std::make_unique<BlockNode>();
-    auto return_stmt = std::make_unique<ReturnNode>();
-    auto multiply = std::make_unique<BinaryOpNode>("*");
-    multiply->left = std::make_unique<NameNode>("a");
-    multiply->right = std::make_unique<NameNode>("b");
-    return_stmt->value = std::move(multiply);
-    calculate_body->statements.push_back(std::move(return_stmt));
-    calculate_func.body = std::move(calculate_body);
+    auto calculate_body = program.make<BlockNode>();
+    auto return_stmt = program.make<ReturnNode>();
+    auto multiply = program.make<BinaryOpNode>("*");
+    multiply->left = program.make<NameNode>("a");
+    multiply->right = program.make<NameNode>("b");
+    return_stmt->value = multiply;
+    calculate_body->statements.push_back(return_stmt);
+    calculate_func.body = calculate_body;
     
     // Code: int main() { int x = 5; int y = calculate(x, 10); return y; }
     std::cout << "✓ Adding: int main() { int x = 5; int y = calculate(x, 10); return y; }" << std::endl;
     program.functions.emplace_back("int", "main");
     FunctionNode& main_func = program.functions.back();
     
-    auto main_body = std::make_unique<BlockNode>();
+    auto main_body = program.make<BlockNode>();
     
     // int x = 5;
-    auto x_var = std::make_unique<VariableNode>();
+    auto x_var = program.make<VariableNode>();
     x_var->type = "int";
     x_var->name = "x";
-    x_var->value = std::make_unique<LiteralNode>("int", "5");
-    main_body->statements.push_back(std::move(x_var));
+    x_var->value = program.make<LiteralNode>("int", "5");
+    main_body->statements.push_back(x_var);
     
     // int y = calculate(x, 10);
-    auto y_var = std::make_unique<VariableNode>();
+    auto y_var = program.make<VariableNode>();
     y_var->type = "int";
     y_var->name = "y";
-    auto calculate_call = std::make_unique<CallNode>();
+    auto calculate_call = program.make<CallNode>();
     calculate_call->name = "calculate";
-    calculate_call->args.push_back(std::make_unique<NameNode>("x"));
-    calculate_call->args.push_back(std::make_unique<LiteralNode>("int", "10"));
-    y_var->value = std::move(calculate_call);
-    main_body->statements.push_back(std::move(y_var));
+    calculate_call->args.push_back(program.make<NameNode>("x"));
+    calculate_call->args.push_back(program.make<LiteralNode>("int", "10"));
+    y_var->value = calculate_call;
+    main_body->statements.push_back(y_var);
     
     // return y;
-    auto main_return = std::make_unique<ReturnNode>();
-    main_return->value = std::make_unique<NameNode>("y");
-    main_body->statements.push_back(std::move(main_return));
+    auto main_return = program.make<ReturnNode>();
+    main_return->value = program.make<NameNode>("y");
+    main_body->statements.push_back(main_return);
     
-    main_func.body = std::move(main_body);
+    main_func.body = main_body;
     
     // =============================================
     // TEST CASE 2: Error - Undeclared Variable
@@ -79,10 +98,10 @@ int main() {
     // Code: int result = unknown_var * 2;  // 'unknown_var' not declared!
     std::cout << "✗ Adding: int result = unknown_var * 2;  // ERROR: unknown_var not declared" << std::endl;
     program.globals.emplace_back("int", "result");
-    auto error_expr = std::make_unique<BinaryOpNode>("*");
-    error_expr->left = std::make_unique<NameNode>("unknown_var");  // This will cause error
-    error_expr->right = std::make_unique<LiteralNode>("int", "2");
-    program.globals.back().value = std::move(error_expr);
+    auto error_expr = program.make<BinaryOpNode>("*");
+    error_expr->left = program.make<NameNode>("unknown_var");  // This will cause error
+    error_expr->right = program.make<LiteralNode>("int", "2");
+    program.globals.back().value = error_expr;
     
     // =============================================
     // TEST CASE 3: Error - Undefined Function
@@ -93,9 +112,9 @@ int main() {
     // Code: int value = unknown_func();  // 'unknown_func' not defined!
     std::cout << "✗ Adding: int value = unknown_func();  // ERROR: unknown_func not defined" << std::endl;
     program.globals.emplace_back("int", "value");
-    auto error_call = std::make_unique<CallNode>();
+    auto error_call = program.make<CallNode>();
     error_call->name = "unknown_func";  // This will cause error
-    program.globals.back().value = std::move(error_call);
+    program.globals.back().value = error_call;
     
     // =============================================
     // TEST CASE 4: Error - Variable Redefinition
@@ -108,23 +127,23 @@ int main() {
     program.functions.emplace_back("void", "test_redefinition");
     FunctionNode& redef_func = program.functions.back();
     
-    auto redef_body = std::make_unique<BlockNode>();
+    auto redef_body = program.make<BlockNode>();
     
     // int x = 5;
-    auto x1 = std::make_unique<VariableNode>();
+    auto x1 = program.make<VariableNode>();
     x1->type = "int";
     x1->name = "x";
-    x1->value = std::make_unique<LiteralNode>("int", "5");
-    redef_body->statements.push_back(std::move(x1));
+    x1->value = program.make<LiteralNode>("int", "5");
+    redef_body->statements.push_back(x1);
     
     // int x = 10;  // ERROR: x already declared in same scope!
-    auto x2 = std::make_unique<VariableNode>();
+    auto x2 = program.make<VariableNode>();
     x2->type = "int";
     x2->name = "x";  // This will cause error
-    x2->value = std::make_unique<LiteralNode>("int", "10");
-    redef_body->statements.push_back(std::move(x2));
+    x2->value = program.make<LiteralNode>("int", "10");
+    redef_body->statements.push_back(x2);
     
-    redef_func.body = std::move(redef_body);
+    redef_func.body = redef_body;
     
     // =============================================
     // TEST CASE 5: Error - Function Redefinition
@@ -147,55 +166,55 @@ int main() {
     program.functions.emplace_back("void", "control_test");
     FunctionNode& control_func = program.functions.back();
     
-    auto control_body = std::make_unique<BlockNode>();
+    auto control_body = program.make<BlockNode>();
     
     // if (MAX_SIZE > 0) { int temp = MAX_SIZE; }
-    auto if_stmt = std::make_unique<IfNode>();
-    auto if_condition = std::make_unique<BinaryOpNode>(">");
-    if_condition->left = std::make_unique<NameNode>("MAX_SIZE");
-    if_condition->right = std::make_unique<LiteralNode>("int", "0");
-    if_stmt->condition = std::move(if_condition);
-    
-    auto then_block = std::make_unique<BlockNode>();
-    auto temp_var = std::make_unique<VariableNode>();
+    auto if_stmt = program.make<IfNode>();
+    auto if_condition = program.make<BinaryOpNode>(">");
+    if_condition->left = program.make<NameNode>("MAX_SIZE");
+    if_condition->right = program.make<LiteralNode>("int", "0");
+    if_stmt->condition = if_condition;
+    
+    auto then_block = program.make<BlockNode>();
+    auto temp_var = program.make<VariableNode>();
     temp_var->type = "int";
     temp_var->name = "temp";
-    temp_var->value = std::make_unique<NameNode>("MAX_SIZE");
-    then_block->statements.push_back(std::move(temp_var));
-    if_stmt->then_branch = std::move(then_block);
+    temp_var->value = program.make<NameNode>("MAX_SIZE");
+    then_block->statements.push_back(temp_var);
+    if_stmt->then_branch = then_block;
     
-    control_body->statements.push_back(std::move(if_stmt));
+    control_body->statements.push_back(if_stmt);
     
     // while (true) { break; } - simplified
-    auto while_loop = std::make_unique<WhileNode>();
-    while_loop->condition = std::make_unique<LiteralNode>("bool", "true");
-    while_loop->body = std::make_unique<BlockNode>();  // Empty body
-    control_body->statements.push_back(std::move(while_loop));
+    auto while_loop = program.make<WhileNode>();
+    while_loop->condition = program.make<LiteralNode>("bool", "true");
+    while_loop->body = program.make<BlockNode>();  // Empty body
+    control_body->statements.push_back(while_loop);
     
     // for (int i = 0; i < 10; i++) { }
-    auto for_loop = std::make_unique<ForNode>();
-    auto for_init = std::make_unique<VariableNode>();
+    auto for_loop = program.make<ForNode>();
+    auto for_init = program.make<VariableNode>();
     for_init->type = "int";
     for_init->name = "i";
-    for_init->value = std::make_unique<LiteralNode>("int", "0");
-    for_loop->initializer = std::move(for_init);
+    for_init->value = program.make<LiteralNode>("int", "0");
+    for_loop->initializer = for_init;
     
-    auto for_cond = std::make_unique<BinaryOpNode>("<");
-    for_cond->left = std::make_unique<NameNode>("i");
-    for_cond->right = std::make_unique<LiteralNode>("int", "10");
-    for_loop->condition = std::move(for_cond);
+    auto for_cond = program.make<BinaryOpNode>("<");
+    for_cond->left = program.make<NameNode>("i");
+    for_cond->right = program.make<LiteralNode>("int", "10");
+    for_loop->condition = for_cond;
     
-    auto for_inc = std::make_unique<AssignmentNode>("i");
-    auto inc_val = std::make_unique<BinaryOpNode>("+");
-    inc_val->left = std::make_unique<NameNode>("i");
-    inc_val->right = std::make_unique<LiteralNode>("int", "1");
-    for_inc->value = std::move(inc_val);
-    for_loop->increment = std::move(for_inc);
+    auto for_inc = program.make<AssignmentNode>("i");
+    auto inc_val = program.make<BinaryOpNode>("+");
+    inc_val->left = program.make<NameNode>("i");
+    inc_val->right = program.make<LiteralNode>("int", "1");
+    for_inc->value = inc_val;
+    for_loop->increment = for_inc;
     
-    for_loop->body = std::make_unique<BlockNode>();  // Empty body
-    control_body->statements.push_back(std::move(for_loop));
+    for_loop->body = program.make<BlockNode>();  // Empty body
+    control_body->statements.push_back(for_loop);
     
-    control_func.body = std::move(control_body);
+    control_func.body = control_body;
     
     // =============================================
     // TEST CASE 7: Assignment Statement
@@ -208,31 +227,31 @@ int main() {
     program.functions.emplace_back("void", "assignment_test");
     FunctionNode& assign_func = program.functions.back();
     
-    auto assign_body = std::make_unique<BlockNode>();
+    auto assign_body = program.make<BlockNode>();
     
     // First declare y
-    auto y_decl = std::make_unique<VariableNode>();
+    auto y_decl = program.make<VariableNode>();
     y_decl->type = "int";
     y_decl->name = "y";
-    y_decl->value = std::make_unique<LiteralNode>("int", "10");
-    assign_body->statements.push_back(std::move(y_decl));
+    y_decl->value = program.make<LiteralNode>("int", "10");
+    assign_body->statements.push_back(y_decl);
     
     // Then declare x
-    auto x_decl = std::make_unique<VariableNode>();
+    auto x_decl = program.make<VariableNode>();
     x_decl->type = "int";
     x_decl->name = "x";
-    x_decl->value = std::make_unique<LiteralNode>("int", "0");
-    assign_body->statements.push_back(std::move(x_decl));
+    x_decl->value = program.make<LiteralNode>("int", "0");
+    assign_body->statements.push_back(x_decl);
     
     // Assignment: x = y + 5;
-    auto assignment = std::make_unique<AssignmentNode>("x");
-    auto assign_expr = std::make_unique<BinaryOpNode>("+");
-    assign_expr->left = std::make_unique<NameNode>("y");
-    assign_expr->right = std::make_unique<LiteralNode>("int", "5");
-    assignment->value = std::move(assign_expr);
-    assign_body->statements.push_back(std::move(assignment));
+    auto assignment = program.make<AssignmentNode>("x");
+    auto assign_expr = program.make<BinaryOpNode>("+");
+    assign_expr->left = program.make<NameNode>("y");
+    assign_expr->right = program.make<LiteralNode>("int", "5");
+    assignment->value = assign_expr;
+    assign_body->statements.push_back(assignment);
     
-    assign_func.body = std::move(assign_body);
+    assign_func.body = assign_body;
     
     // =============================================
     // TEST CASE 8: Shadowing (Valid)
@@ -245,31 +264,32 @@ int main() {
     program.functions.emplace_back("void", "shadow_test");
     FunctionNode& shadow_func = program.functions.back();
     
-    auto shadow_body = std::make_unique<BlockNode>();
+    auto shadow_body = program.make<BlockNode>();
     
     // Outer x
-    auto outer_x = std::make_unique<VariableNode>();
+    auto outer_x = program.make<VariableNode>();
     outer_x->type = "int";
     outer_x->name = "x";
-    outer_x->value = std::make_unique<LiteralNode>("int", "1");
-    shadow_body->statements.push_back(std::move(outer_x));
+    outer_x->value = program.make<LiteralNode>("int", "1");
+    shadow_body->statements.push_back(outer_x);
     
     // Inner block with shadowing x
-    auto inner_block = std::make_unique<BlockNode>();
-    auto inner_x = std::make_unique<VariableNode>();
+    auto inner_block = program.make<BlockNode>();
+    auto inner_x = program.make<VariableNode>();
     inner_x->type = "int";
     inner_x->name = "x";  // This shadows outer x - allowed!
-    inner_x->value = std::make_unique<LiteralNode>("int", "2");
-    inner_block->statements.push_back(std::move(inner_x));
-    shadow_body->statements.push_back(std::move(inner_block));
+    inner_x->value = program.make<LiteralNode>("int", "2");
+    inner_block->statements.push_back(inner_x);
+    shadow_body->statements.push_back(inner_block);
     
-    shadow_func.body = std::move(shadow_body);
+    shadow_func.body = shadow_body;
     
     std::cout << "\n=== RUNNING SCOPE ANALYSIS ===" << std::endl;
     std::cout << "Testing all cases: valid code, errors, control structures..." << std::endl;
     
     ScopeAnalyzer analyzer;
     bool success = analyzer.check(&program);
+    DiagnosticReporter().report(std::cout, analyzer.getErrors());
     
     std::cout << "\n=== FINAL RESULTS ===" << std::endl;
     std::cout << "Total errors found: " << analyzer.errorCount() << std::endl;
@@ -282,9 +302,9 @@ int main() {
         std::cout << "---------------" << std::endl;
         
         int error_num = 1;
-        for (auto error : analyzer.getErrors()) {
+        for (auto& error : analyzer.getErrors()) {
             std::cout << error_num++ << ". ";
-            switch(error) {
+            switch(error.kind) {
                 case ScopeError::UndeclaredVariable:
                     std::cout << "Undeclared variable used";
                     break;
@@ -308,5 +328,11 @@ int main() {
     std::cout << "✓ Control structures should work correctly" << std::endl;
     std::cout << "✓ Variable shadowing should be allowed" << std::endl;
     
+    if (mem_report) {
+        MemoryReport report = measure_memory(program);
+        report.analyzer = analyzer.getMemory();
+        std::cout << "\n=== MEMORY REPORT ===" << std::endl;
+        print_memory_report(std::cout, report);
+    }
     return 0;
 }
\ No newline at end of file
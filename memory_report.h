@@ -0,0 +1,132 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include "parse_tree.h"
+#include "scope_analyzer.h"
+#include "symbol.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Where the memory of an analyzed program goes: the AST by node kind, the
+// arena it lives in, the interner and the analyzer's scopes. Node bytes
+// are the node itself plus what it owns on the heap (child vectors,
+// operator text); parameters and program-level declarations count as
+// Variable and Function nodes, and their vectors' spare capacity as
+// program_bytes.
+struct MemoryReport {
+    static constexpr size_t kKinds = (size_t)NodeKind::Program + 1;
+
+    uint64_t node_count[kKinds] = {};
+    uint64_t node_bytes[kKinds] = {};
+    size_t program_bytes = 0;
+    size_t arena_capacity = 0;   // chunk memory held by the arena
+    size_t arena_used = 0;       // of which handed out to nodes
+    size_t symbols = 0;
+    size_t interner_bytes = 0;
+    AnalyzerMemory analyzer;
+
+    uint64_t total_node_bytes() const {
+        uint64_t total = 0;
+        for (uint64_t b : node_bytes) total += b;
+        return total;
+    }
+};
+
+namespace memory_report {
+
+inline size_t string_heap(const std::string& s) {
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+template<typename T>
+size_t spare(const std::vector<T>& v) { return (v.capacity() - v.size()) * sizeof(T); }
+
+inline size_t node_size(const ASTNode* node) {
+    switch (node->kind()) {
+        case NodeKind::Variable: return sizeof(VariableNode);
+        case NodeKind::Function: return sizeof(FunctionNode);
+        case NodeKind::Block: {
+            auto block = static_cast<const BlockNode*>(node);
+            return sizeof(BlockNode) + block->statements.capacity() * sizeof(ASTNode*);
+        }
+        case NodeKind::Call: {
+            auto call = static_cast<const CallNode*>(node);
+            return sizeof(CallNode) + call->args.capacity() * sizeof(ASTNode*);
+        }
+        case NodeKind::Name: return sizeof(NameNode);
+        case NodeKind::Literal: return sizeof(LiteralNode);
+        case NodeKind::BinaryOp: {
+            auto binary = static_cast<const BinaryOpNode*>(node);
+            return sizeof(BinaryOpNode) + string_heap(binary->op);
+        }
+        case NodeKind::Assignment: return sizeof(AssignmentNode);
+        case NodeKind::Return: return sizeof(ReturnNode);
+        case NodeKind::If: return sizeof(IfNode);
+        case NodeKind::While: return sizeof(WhileNode);
+        case NodeKind::For: return sizeof(ForNode);
+        case NodeKind::Program: return sizeof(ProgramNode);
+    }
+    return 0;
+}
+
+}
+
+// Walks program and fills in everything but `analyzer`.
+inline MemoryReport measure_memory(const ProgramNode& program) {
+    MemoryReport report;
+    std::vector<const ASTNode*> work;
+    auto count = [&](const ASTNode* node) {
+        size_t k = (size_t)node->kind();
+        ++report.node_count[k];
+        report.node_bytes[k] += memory_report::node_size(node);
+    };
+    auto walk = [&](const ASTNode* root) {
+        work.push_back(root);
+        while (!work.empty()) {
+            const ASTNode* node = work.back();
+            work.pop_back();
+            count(node);
+            for_each_child(node, [&](const ASTNode* child) {
+                if (child) work.push_back(child);
+            });
+        }
+    };
+
+    count(&program);
+    report.program_bytes = memory_report::spare(program.globals) + memory_report::spare(program.functions);
+    for (auto& var : program.globals) walk(&var);
+    for (auto& func : program.functions) {
+        count(&func);
+        report.program_bytes += memory_report::spare(func.params);
+        for (auto& param : func.params) walk(&param);
+        if (func.body) walk(func.body);
+    }
+    report.arena_capacity = program.arena.capacity();
+    report.arena_used = program.arena.used_bytes();
+    report.symbols = interner().size();
+    report.interner_bytes = interner().memory_bytes();
+    return report;
+}
+
+// Human-readable form of report, in KiB.
+inline void print_memory_report(std::ostream& out, const MemoryReport& report) {
+    auto kib = [](double bytes) { return bytes / 1024; };
+    out << "memory (KiB):\n";
+    for (size_t k = 0; k < MemoryReport::kKinds; ++k) {
+        if (!report.node_count[k]) continue;
+        out << "  " << node_kind_name((NodeKind)k) << ": " << kib(report.node_bytes[k])
+            << " (" << report.node_count[k] << " nodes, "
+            << (double)report.node_bytes[k] / report.node_count[k] << " B/node)\n";
+    }
+    out << "  nodes total: " << kib(report.total_node_bytes()) << "\n"
+        << "  program vectors: " << kib(report.program_bytes) << "\n"
+        << "  arena: " << kib(report.arena_used) << " used of " << kib(report.arena_capacity) << "\n"
+        << "  interner: " << kib(report.interner_bytes) << " (" << report.symbols << " symbols)\n"
+        << "  global scope: " << kib(report.analyzer.global_scope_bytes) << "\n"
+        << "  walker scopes: " << kib(report.analyzer.walker_bytes)
+        << " (peak depth " << report.analyzer.peak_scopes << ")\n";
+}
+
+#endif
@@ -1,91 +1,307 @@
 #ifndef PARSE_TREE_H
 #define PARSE_TREE_H
 
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <memory>
+#include <utility>
+#include "ast_arena.h"
+#include "symbol.h"
 
+// Tag used by passes to dispatch on the concrete node type without RTTI.
+enum class NodeKind {
+    Variable,
+    Function,
+    Block,
+    Call,
+    Name,
+    Literal,
+    BinaryOp,
+    Assignment,
+    Return,
+    If,
+    While,
+    For,
+    Program
+};
+
+inline const char* node_kind_name(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Variable: return "Variable";
+        case NodeKind::Function: return "Function";
+        case NodeKind::Block: return "Block";
+        case NodeKind::Call: return "Call";
+        case NodeKind::Name: return "Name";
+        case NodeKind::Literal: return "Literal";
+        case NodeKind::BinaryOp: return "BinaryOp";
+        case NodeKind::Assignment: return "Assignment";
+        case NodeKind::Return: return "Return";
+        case NodeKind::If: return "If";
+        case NodeKind::While: return "While";
+        case NodeKind::For: return "For";
+        case NodeKind::Program: return "Program";
+    }
+    return "Unknown";
+}
+
+// Position in the source the node was parsed from; 0 when unknown.
+struct SourceLocation {
+    uint32_t line = 0;
+    uint32_t column = 0;
+    
+    bool known() const { return line != 0; }
+};
+
+// Nodes are allocated from the ASTArena of their ProgramNode and refer to
+// their children through plain pointers; the arena owns all of them.
+// The kind is fixed by the constructor but not const, so nodes stay
+// assignable and vectors of them support insert and erase.
 struct ASTNode {
-    virtual ~ASTNode() = default;
+private:
+    NodeKind node_kind;
+
+public:
+    SourceLocation loc;
+    
+    explicit ASTNode(NodeKind k) : node_kind(k) {}
+    
+    NodeKind kind() const { return node_kind; }
+
+protected:
+    ~ASTNode() = default;
 };
 
 struct VariableNode : ASTNode {
-    std::string type;
-    std::string name;
-    std::unique_ptr<ASTNode> value;
+    Symbol type;
+    Symbol name;
+    ASTNode* value = nullptr;
     
-    VariableNode() = default;
-    VariableNode(const std::string& t, const std::string& n) : type(t), name(n) {}
+    VariableNode() : ASTNode(NodeKind::Variable) {}
+    VariableNode(Symbol t, Symbol n) : ASTNode(NodeKind::Variable), type(t), name(n) {}
 };
 
 struct FunctionNode : ASTNode {
-    std::string return_type;
-    std::string name;
+    Symbol return_type;
+    Symbol name;
     std::vector<VariableNode> params;
-    std::unique_ptr<ASTNode> body;
+    ASTNode* body = nullptr;
     
-    FunctionNode() = default;
-    FunctionNode(const std::string& ret, const std::string& n) : return_type(ret), name(n) {}
+    FunctionNode() : ASTNode(NodeKind::Function) {}
+    FunctionNode(Symbol ret, Symbol n) : ASTNode(NodeKind::Function), return_type(ret), name(n) {}
 };
 
 struct BlockNode : ASTNode {
-    std::vector<std::unique_ptr<ASTNode>> statements;
+    std::vector<ASTNode*> statements;
+    BlockNode() : ASTNode(NodeKind::Block) {}
 };
 
 struct CallNode : ASTNode {
-    std::string name;
-    std::vector<std::unique_ptr<ASTNode>> args;
+    Symbol name;
+    std::vector<ASTNode*> args;
+    const FunctionNode* callee = nullptr;   // set by scope analysis
+    CallNode() : ASTNode(NodeKind::Call) {}
+    CallNode(Symbol n) : ASTNode(NodeKind::Call), name(n) {}
 };
 
 struct NameNode : ASTNode {
-    std::string name;
-    NameNode(const std::string& n) : name(n) {}
+    Symbol name;
+    const ASTNode* decl = nullptr;   // declaration, set by scope analysis
+    NameNode(Symbol n) : ASTNode(NodeKind::Name), name(n) {}
 };
 
+// Type of a literal. The first four line up with the type checker's
+// BasicType; any other type name reads as Unknown.
+enum class LiteralKind : uint8_t {
+    Int,
+    Float,
+    Bool,
+    String,
+    Unknown
+};
+
+// Literals hold their value inline: `bits` is the Int value, the bit
+// pattern of the Float or 0/1 for Bool, and only String (and Unknown)
+// literals refer to interned text.
 struct LiteralNode : ASTNode {
-    std::string type;
-    std::string value;
-    LiteralNode(const std::string& t, const std::string& v) : type(t), value(v) {}
+    LiteralKind type;
+    Symbol text;
+    int64_t bits = 0;
+
+    explicit LiteralNode(int64_t v) : ASTNode(NodeKind::Literal), type(LiteralKind::Int), bits(v) {}
+    explicit LiteralNode(double v) : ASTNode(NodeKind::Literal), type(LiteralKind::Float) { std::memcpy(&bits, &v, sizeof(v)); }
+    explicit LiteralNode(bool v) : ASTNode(NodeKind::Literal), type(LiteralKind::Bool), bits(v) {}
+    explicit LiteralNode(Symbol string) : ASTNode(NodeKind::Literal), type(LiteralKind::String), text(string) {}
+    LiteralNode(const char*) = delete;   // would silently pick the bool overload
+    LiteralNode(LiteralKind k, Symbol t, int64_t b) : ASTNode(NodeKind::Literal), type(k), text(t), bits(b) {}
+
+    // From source text, e.g. ("int", "100"). The value is parsed once here;
+    // a numeric value that does not parse reads as 0.
+    LiteralNode(std::string_view type_name, std::string_view value) : ASTNode(NodeKind::Literal) {
+        if (type_name == "int") {
+            type = LiteralKind::Int;
+            std::from_chars(value.data(), value.data() + value.size(), bits);
+        } else if (type_name == "float") {
+            type = LiteralKind::Float;
+            double v = std::strtod(std::string(value).c_str(), nullptr);
+            std::memcpy(&bits, &v, sizeof(v));
+        } else if (type_name == "bool") {
+            type = LiteralKind::Bool;
+            bits = value == "true";
+        } else {
+            type = type_name == "string" ? LiteralKind::String : LiteralKind::Unknown;
+            text = Symbol(value);
+        }
+    }
+
+    int64_t int_value() const { return bits; }
+    double float_value() const {
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    bool bool_value() const { return bits != 0; }
 };
 
 struct BinaryOpNode : ASTNode {
     std::string op;
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
-    BinaryOpNode(const std::string& o) : op(o) {}
+    ASTNode* left = nullptr;
+    ASTNode* right = nullptr;
+    BinaryOpNode(std::string o) : ASTNode(NodeKind::BinaryOp), op(std::move(o)) {}
 };
 
 struct AssignmentNode : ASTNode {
-    std::string name;
-    std::unique_ptr<ASTNode> value;
-    AssignmentNode(const std::string& n) : name(n) {}
+    Symbol name;
+    ASTNode* value = nullptr;
+    const ASTNode* decl = nullptr;   // declaration, set by scope analysis
+    AssignmentNode(Symbol n) : ASTNode(NodeKind::Assignment), name(n) {}
 };
 
 struct ReturnNode : ASTNode {
-    std::unique_ptr<ASTNode> value;
+    ASTNode* value = nullptr;
+    ReturnNode() : ASTNode(NodeKind::Return) {}
 };
 
 struct IfNode : ASTNode {
-    std::unique_ptr<ASTNode> condition;
-    std::unique_ptr<ASTNode> then_branch;
-    std::unique_ptr<ASTNode> else_branch;
+    ASTNode* condition = nullptr;
+    ASTNode* then_branch = nullptr;
+    ASTNode* else_branch = nullptr;
+    IfNode() : ASTNode(NodeKind::If) {}
 };
 
 struct WhileNode : ASTNode {
-    std::unique_ptr<ASTNode> condition;
-    std::unique_ptr<ASTNode> body;
+    ASTNode* condition = nullptr;
+    ASTNode* body = nullptr;
+    WhileNode() : ASTNode(NodeKind::While) {}
 };
 
 struct ForNode : ASTNode {
-    std::unique_ptr<ASTNode> initializer;
-    std::unique_ptr<ASTNode> condition;
-    std::unique_ptr<ASTNode> increment;
-    std::unique_ptr<ASTNode> body;
+    ASTNode* initializer = nullptr;
+    ASTNode* condition = nullptr;
+    ASTNode* increment = nullptr;
+    ASTNode* body = nullptr;
+    ForNode() : ASTNode(NodeKind::For) {}
 };
 
 struct ProgramNode : ASTNode {
     std::vector<FunctionNode> functions;
     std::vector<VariableNode> globals;
+    ASTArena arena;
+    ProgramNode() : ASTNode(NodeKind::Program) {}
+    
+    // Allocates a node owned by this program.
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        return arena.make<T>(std::forward<Args>(args)...);
+    }
+    
+    // Size hints for builders that know the program's shape up front.
+    // With enough capacity, references returned by add_function and
+    // add_global stay valid while the rest of the program is built.
+    void reserve(size_t function_count, size_t global_count, size_t node_bytes = 0) {
+        functions.reserve(function_count);
+        globals.reserve(global_count);
+        if (node_bytes) arena.reserve(node_bytes);
+    }
+    
+    FunctionNode& add_function(Symbol return_type, Symbol name) {
+        functions.emplace_back(return_type, name);
+        return functions.back();
+    }
+    
+    VariableNode& add_global(Symbol type, Symbol name) {
+        globals.emplace_back(type, name);
+        return globals.back();
+    }
+    
+    // Empties the program for reuse, keeping its vectors' and arena's
+    // memory.
+    void clear() {
+        functions.clear();
+        globals.clear();
+        arena.reset();
+    }
 };
 
+// Calls f(child) for every child slot of node in source order, including
+// empty (null) optional children. Function parameters and program-level
+// globals/functions are not ASTNode pointers and are not visited.
+template<typename F>
+void for_each_child(const ASTNode* node, F&& f) {
+    switch (node->kind()) {
+        case NodeKind::Variable:
+            f(static_cast<const VariableNode*>(node)->value);
+            break;
+        case NodeKind::Function:
+            f(static_cast<const FunctionNode*>(node)->body);
+            break;
+        case NodeKind::Block:
+            for (auto stmt : static_cast<const BlockNode*>(node)->statements) f(stmt);
+            break;
+        case NodeKind::Call:
+            for (auto arg : static_cast<const CallNode*>(node)->args) f(arg);
+            break;
+        case NodeKind::BinaryOp: {
+            auto binary = static_cast<const BinaryOpNode*>(node);
+            f(binary->left);
+            f(binary->right);
+            break;
+        }
+        case NodeKind::Assignment:
+            f(static_cast<const AssignmentNode*>(node)->value);
+            break;
+        case NodeKind::Return:
+            f(static_cast<const ReturnNode*>(node)->value);
+            break;
+        case NodeKind::If: {
+            auto if_stmt = static_cast<const IfNode*>(node);
+            f(if_stmt->condition);
+            f(if_stmt->then_branch);
+            f(if_stmt->else_branch);
+            break;
+        }
+        case NodeKind::While: {
+            auto while_stmt = static_cast<const WhileNode*>(node);
+            f(while_stmt->condition);
+            f(while_stmt->body);
+            break;
+        }
+        case NodeKind::For: {
+            auto for_stmt = static_cast<const ForNode*>(node);
+            f(for_stmt->initializer);
+            f(for_stmt->condition);
+            f(for_stmt->increment);
+            f(for_stmt->body);
+            break;
+        }
+        case NodeKind::Name:
+        case NodeKind::Literal:
+        case NodeKind::Program:
+            break;
+    }
+}
+
 #endif
\ No newline at end of file
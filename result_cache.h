@@ -0,0 +1,332 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "ast_hash.h"
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Diagnostics of one function body, stored under the structural hash of
+// the function. `deps` records every global name the body looked up and a
+// fingerprint of what the name was bound to, which decides whether the
+// entry still applies. Lines are relative to the function's own line.
+struct CachedResult {
+    std::vector<std::pair<Symbol, uint64_t>> deps;
+    std::vector<Diagnostic> errors;
+    std::vector<TypeDiagnostic> type_errors;
+};
+
+// What `name` is bound to in `global`, as far as checking a body that
+// uses it can tell: the type of the variable of that name, if any, and
+// the signature of the function of that name, if any. Equal fingerprints
+// give equal diagnostics.
+inline uint64_t binding_fingerprint(const Scope& global, Symbol name) {
+    uint64_t h = 1;
+    auto mix = [&h](uint64_t v) { h = (h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2))) * 0xff51afd7ed558ccdull; };
+    if (const Binding* b = global.resolve(name)) mix(b->type.stable_hash());
+    else mix(0);
+    FunctionSignature func = global.find_function(name);
+    if (!func) return h;
+    mix(func.return_type.stable_hash());
+    mix(func.param_count);
+    for (uint32_t i = 0; i < func.param_count; ++i) mix(func.param_types[i].stable_hash());
+    return h;
+}
+
+// Directory of cached function results, one file per key. Files are
+// written to a private temporary name and renamed into place, so
+// processes sharing the directory only ever see complete entries; when
+// two of them store the same key, the last rename wins. Each file carries
+// a version and a checksum and is ignored if either does not match.
+class ResultCache {
+    std::string dir;
+    std::atomic<uint64_t> temp_counter{0};
+
+    static constexpr char kMagic[8] = {'S', 'C', 'O', 'P', 'E', 'R', 'E', 'S'};
+    static constexpr uint32_t kVersion = 1;
+
+    struct Writer {
+        std::string out;
+        void u8(uint8_t v) { out += (char)v; }
+        void u32(uint32_t v) { out.append(reinterpret_cast<const char*>(&v), 4); }
+        void u64(uint64_t v) { out.append(reinterpret_cast<const char*>(&v), 8); }
+        void text(Symbol s) {
+            const std::string& t = s.str();
+            u32((uint32_t)t.size());
+            out += t;
+        }
+    };
+
+    struct Reader {
+        const char* p;
+        const char* end;
+        bool ok = true;
+        bool take(void* v, size_t n) {
+            if ((size_t)(end - p) < n) return ok = false;
+            std::memcpy(v, p, n);
+            p += n;
+            return true;
+        }
+        uint8_t u8() { uint8_t v = 0; take(&v, 1); return v; }
+        uint32_t u32() { uint32_t v = 0; take(&v, 4); return v; }
+        uint64_t u64() { uint64_t v = 0; take(&v, 8); return v; }
+        Symbol text() {
+            uint32_t n = u32();
+            if (!ok || (size_t)(end - p) < n) {
+                ok = false;
+                return Symbol();
+            }
+            Symbol s(std::string_view(p, n));
+            p += n;
+            return s;
+        }
+    };
+
+    std::string path(uint64_t key) const {
+        char name[24];
+        std::snprintf(name, sizeof(name), "%016llx.res", (unsigned long long)key);
+        return dir + "/" + name;
+    }
+
+public:
+    // Creates the directory if needed.
+    explicit ResultCache(std::string directory) : dir(std::move(directory)) {
+        ::mkdir(dir.c_str(), 0777);
+    }
+
+    bool load(uint64_t key, CachedResult& out) const {
+        int fd = ::open(path(key).c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        std::string data;
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            data.resize((size_t)st.st_size);
+            if (::read(fd, &data[0], data.size()) != (ssize_t)data.size()) data.clear();
+        }
+        ::close(fd);
+
+        const size_t header = sizeof(kMagic) + 4 + 8;
+        if (data.size() < header || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) return false;
+        Reader r{data.data() + sizeof(kMagic), data.data() + data.size()};
+        if (r.u32() != kVersion) return false;
+        uint64_t checksum = r.u64();
+        if (checksum != fnv1a(r.p, (size_t)(r.end - r.p))) return false;
+
+        out = CachedResult();
+        uint32_t deps = r.u32();
+        for (uint32_t i = 0; i < deps && r.ok; ++i) {
+            Symbol name = r.text();
+            out.deps.push_back({name, r.u64()});
+        }
+        uint32_t errors = r.u32();
+        for (uint32_t i = 0; i < errors && r.ok; ++i) {
+            Diagnostic d;
+            d.kind = (ScopeError)r.u8();
+            d.loc.line = r.u32();
+            d.loc.column = r.u32();
+            d.name = r.text();
+            out.errors.push_back(d);
+        }
+        uint32_t type_errors = r.u32();
+        for (uint32_t i = 0; i < type_errors && r.ok; ++i) {
+            TypeDiagnostic d;
+            d.kind = (TypeError)r.u8();
+            d.expected = (BasicType)r.u8();
+            d.actual = (BasicType)r.u8();
+            d.loc.line = r.u32();
+            d.loc.column = r.u32();
+            d.name = r.text();
+            out.type_errors.push_back(d);
+        }
+        return r.ok && r.p == r.end;
+    }
+
+    bool store(uint64_t key, const CachedResult& result) {
+        Writer w;
+        w.u32((uint32_t)result.deps.size());
+        for (auto& dep : result.deps) {
+            w.text(dep.first);
+            w.u64(dep.second);
+        }
+        w.u32((uint32_t)result.errors.size());
+        for (auto& d : result.errors) {
+            w.u8((uint8_t)d.kind);
+            w.u32(d.loc.line);
+            w.u32(d.loc.column);
+            w.text(d.name);
+        }
+        w.u32((uint32_t)result.type_errors.size());
+        for (auto& d : result.type_errors) {
+            w.u8((uint8_t)d.kind);
+            w.u8((uint8_t)d.expected);
+            w.u8((uint8_t)d.actual);
+            w.u32(d.loc.line);
+            w.u32(d.loc.column);
+            w.text(d.name);
+        }
+
+        Writer header;
+        header.out.append(kMagic, sizeof(kMagic));
+        header.u32(kVersion);
+        header.u64(fnv1a(w.out.data(), w.out.size()));
+
+        std::string target = path(key);
+        std::string tmp = target + ".tmp." + std::to_string((long)::getpid()) + "." + std::to_string(temp_counter++);
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(header.out.data(), header.out.size(), 1, f) == 1
+               && std::fwrite(w.out.data(), w.out.size(), 1, f) == 1;
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok || std::rename(tmp.c_str(), target.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// ScopeAnalyzer that looks every function body up in a ResultCache first.
+// A hit, a stored entry whose dependencies are bound as they were, skips
+// the scope and type checks of that body and replays its diagnostics; a
+// miss checks it and updates the entry. The output is the same as
+// ScopeAnalyzer::check's, except that replayed bodies get no resolution
+// links. Declarations and global initializers are always checked. Error
+// limits and verdict_only are applied to the merged diagnostics, after
+// replay, so every body is still looked up or checked and cached.
+class CachedAnalyzer {
+    AnalyzerOptions options;
+    ResultCache& cache;
+    std::vector<Diagnostic> errors;
+    std::vector<TypeDiagnostic> type_errors;
+    std::atomic<size_t> hits{0};
+    size_t limit = 0;
+    bool failed = false;
+
+    size_t found() const { return errors.size() + type_errors.size(); }
+    bool limit_reached() const { return limit && found() >= limit; }
+
+    // Appends one unit's scope errors, then its type errors, up to the
+    // limit, as ScopeAnalyzer does.
+    void take(const std::vector<Diagnostic>& scope, const std::vector<TypeDiagnostic>& types) {
+        size_t room = limit ? limit - std::min(limit, found()) : scope.size();
+        size_t n = std::min(scope.size(), room);
+        errors.insert(errors.end(), scope.begin(), scope.begin() + n);
+        room = limit ? limit - std::min(limit, found()) : types.size();
+        n = std::min(types.size(), room);
+        type_errors.insert(type_errors.end(), types.begin(), types.begin() + n);
+    }
+
+    struct Worker {
+        ScopeWalker walker;
+        TypeChecker types;
+        std::vector<Symbol> refs;
+        Worker(const Scope& global) : walker(global) {}
+    };
+
+    template<typename D>
+    static void shift_lines(std::vector<D>& diags, SourceLocation origin, bool to_relative) {
+        if (!origin.known()) return;
+        for (auto& d : diags) {
+            if (!d.loc.known()) continue;
+            d.loc.line = to_relative ? d.loc.line - origin.line + 1 : d.loc.line + origin.line - 1;
+        }
+    }
+
+    bool replay(const CachedResult& entry, const Scope& global) const {
+        for (auto& dep : entry.deps) {
+            if (binding_fingerprint(global, dep.first) != dep.second) return false;
+        }
+        return true;
+    }
+
+    void check_function(Worker& w, FunctionNode* func, const Scope& global, CachedResult& result) {
+        uint64_t key = hash_function(*func) ^ (options.check_types ? 0x5bd1e9955bd1e995ull : 0);
+        if (cache.load(key, result) && replay(result, global)) {
+            ++hits;
+            shift_lines(result.errors, func->loc, false);
+            shift_lines(result.type_errors, func->loc, false);
+            return;
+        }
+
+        w.refs.clear();
+        w.walker.check_function(func);
+        if (options.check_types) w.types.check_function(func);
+        std::sort(w.refs.begin(), w.refs.end());
+        w.refs.erase(std::unique(w.refs.begin(), w.refs.end()), w.refs.end());
+
+        result = CachedResult();
+        for (Symbol name : w.refs) result.deps.push_back({name, binding_fingerprint(global, name)});
+        result.errors.swap(w.walker.errors);
+        result.type_errors.swap(w.types.errors);
+        shift_lines(result.errors, func->loc, true);
+        shift_lines(result.type_errors, func->loc, true);
+        cache.store(key, result);
+        shift_lines(result.errors, func->loc, false);
+        shift_lines(result.type_errors, func->loc, false);
+    }
+
+public:
+    CachedAnalyzer(ResultCache& c, const AnalyzerOptions& opts = AnalyzerOptions()) : options(opts), cache(c) {}
+
+    bool check(ProgramNode* program) {
+        errors.clear();
+        type_errors.clear();
+        hits = 0;
+        limit = options.error_limit();
+        failed = false;
+
+        // PHASE 1: Global declarations
+        Scope global;
+        declare_globals(program, global, errors);
+        if (limit_reached()) errors.resize(limit);
+
+        // PHASE 2: Function bodies
+        auto& functions = program->functions;
+        unsigned workers = resolve_thread_count(options.threads);
+        std::vector<Worker> pool(workers, Worker(global));
+        for (auto& w : pool) w.walker.track_global_refs(&w.refs);
+        std::vector<CachedResult> results(functions.size());
+        parallel_for(functions.size(), workers, [&](unsigned worker, size_t i) {
+            check_function(pool[worker], &functions[i], global, results[i]);
+        });
+        for (auto& result : results) take(result.errors, result.type_errors);
+
+        // PHASE 3: Global initializers
+        ScopeWalker walker(global, &global);
+        TypeChecker types;
+        for (auto& var : program->globals) {
+            if (!var.value) continue;
+            if (limit_reached()) break;
+            walker.check_node(var.value);
+            if (options.check_types) types.check_global(&var);
+            take(walker.errors, types.errors);
+            walker.errors.clear();
+            types.errors.clear();
+        }
+
+        if (options.verdict_only) {
+            failed = found() != 0;
+            errors.clear();
+            type_errors.clear();
+        }
+        return passed();
+    }
+
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+    const std::vector<TypeDiagnostic>& getTypeErrors() const { return type_errors; }
+    bool passed() const { return !failed && errors.empty() && type_errors.empty(); }
+    size_t errorCount() const { return errors.size(); }
+    // Function bodies replayed from the cache by the last check().
+    size_t hitCount() const { return hits; }
+};
+
+#endif
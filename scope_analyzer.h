@@ -2,185 +2,837 @@
 #define SCOPE_ANALYZER_H
 
 #include "parse_tree.h"
+#include "analyzer_policy.h"
+#include "analyzer_stats.h"
+#include "diagnostics.h"
+#include "function_table.h"
+#include "scope_stack.h"
+#include "symbol_search.h"
+#include "thread_pool.h"
+#include "type_checker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <vector>
 #include <unordered_map>
-#include <iostream>
 
-enum class ScopeError {
-    UndeclaredVariable,
-    UndefinedFunction,
-    VariableRedefined,
-    FunctionRedefined
+struct AnalyzerOptions {
+    // Workers used for function bodies; 1 checks them on the calling
+    // thread, 0 uses one worker per hardware thread.
+    unsigned threads = 1;
+    // Also run the TypeChecker on every body and initializer right after
+    // its scope check, while the nodes are still in cache.
+    bool check_types = false;
+    // Stop once this many diagnostics (scope and type errors together)
+    // have been found; 0 means no limit. The diagnostics kept are the
+    // first ones in source order, whatever the number of threads.
+    size_t max_errors = 0;
+    // Same as max_errors = 1.
+    bool stop_at_first_error = false;
+    // Only passed() is wanted: stop at the first error and keep no
+    // diagnostics.
+    bool verdict_only = false;
+    
+    size_t error_limit() const {
+        if (stop_at_first_error || verdict_only) return 1;
+        return max_errors;
+    }
 };
 
+// Scope memory of the last ScopeAnalyzer::check, for sizing workers.
+struct AnalyzerMemory {
+    size_t global_scope_bytes = 0;
+    size_t walker_bytes = 0;   // scope stacks and work stacks of all walkers
+    uint32_t peak_scopes = 0;  // most scopes open at once in one walker
+};
+
+// Flat table of one scope's declarations. Most scopes hold a handful of
+// names, so the first kInlineCapacity bindings live inline and are found
+// by a (vectorized) scan over their symbol ids; only a scope that grows past
+// that moves them into a hash table. Block scopes inside functions use
+// ScopeStack instead; this is for global, prelude and initializer scopes.
+// Functions are a separate namespace: a global scope also carries a
+// FunctionTable, layered on the parent scope's.
 class Scope {
 public:
-    Scope* parent;
-    std::unordered_map<std::string, std::string> symbols;
+    static constexpr uint32_t kInlineCapacity = 16;
+    
+    const Scope* parent;
     
-    Scope(Scope* p = nullptr) : parent(p) {}
+    Scope(const Scope* p = nullptr) : parent(p), function_table(p ? &p->function_table : nullptr) {}
     
-    bool add(const std::string& name, const std::string& type) {
-        if (symbols.count(name)) return false;
-        symbols[name] = type;
+    bool add(Symbol name, Symbol type, const ASTNode* decl = nullptr) {
+        if (!spilled) {
+            if (find_inline(name) >= 0) return false;
+            if (count < kInlineCapacity) {
+                inline_ids[count] = name.id;
+                inline_bindings[count] = Binding{type, decl};
+                ++count;
+                return true;
+            }
+            spill();
+        }
+        if (!table.emplace(name, Binding{type, decl}).second) return false;
+        ++count;
         return true;
     }
     
-    bool in_scope(const std::string& name) {
-        return symbols.count(name);
+    // Declares a function; fails only if a function of that name is
+    // already declared in this scope.
+    bool add_function(const FunctionNode& func) { return function_table.add(func); }
+    bool add_function(Symbol name, Symbol return_type) { return function_table.add(name, return_type); }
+    
+    // Nearest declaration of the function name along the parent chain.
+    FunctionSignature find_function(Symbol name) const { return function_table.find(name); }
+    
+    const FunctionTable& functions() const { return function_table; }
+    void reserve_functions(size_t functions, size_t params = 0) { function_table.reserve(functions, params); }
+    
+    bool in_scope(Symbol name) const {
+        return lookup_local(name) != nullptr;
     }
     
-    std::string find(const std::string& name) {
-        auto it = symbols.find(name);
-        if (it != symbols.end()) return it->second;
-        if (parent) return parent->find(name);
-        return "";
+    // Returns the declared type, or an empty Symbol if name is not visible.
+    Symbol find(Symbol name) const {
+        const Binding* b = resolve(name);
+        return b ? b->type : Symbol();
     }
-};
-
-class ScopeAnalyzer {
-    std::vector<ScopeError> errors;
-    Scope* current;
-    Scope* global;
     
-    void error(ScopeError err, const std::string& name) {
-        errors.push_back(err);
-        std::string msg;
-        switch(err) {
-            case ScopeError::UndefinedFunction: msg = "Undefined function: " + name; break;
-            case ScopeError::UndeclaredVariable: msg = "Undeclared variable: " + name; break;
-            case ScopeError::VariableRedefined: msg = "Variable redefined: " + name; break;
-            case ScopeError::FunctionRedefined: msg = "Function redefined: " + name; break;
+    // Nearest binding of name along the parent chain, or null.
+    const Binding* resolve(Symbol name) const {
+        for (const Scope* s = this; s; s = s->parent) {
+            if (const Binding* b = s->lookup_local(name)) return b;
         }
-        std::cout << "Error: " << msg << std::endl;
+        return nullptr;
     }
     
-    void enter_scope() { current = new Scope(current); }
-    void leave_scope() { Scope* old = current; current = current->parent; delete old; }
-    
-public:
-    ScopeAnalyzer() {
-        global = new Scope();
-        current = global;
+    // Same, also adding the number of scopes looked at to `walked`.
+    const Binding* resolve(Symbol name, uint64_t& walked) const {
+        for (const Scope* s = this; s; s = s->parent) {
+            ++walked;
+            if (const Binding* b = s->lookup_local(name)) return b;
+        }
+        return nullptr;
     }
     
-    ~ScopeAnalyzer() {
-        while (current != nullptr) {
-            Scope* old = current;
-            current = current->parent;
-            delete old;
+    // Binding of name in this scope only, or null.
+    const Binding* lookup_local(Symbol name) const {
+        if (!spilled) {
+            int i = find_inline(name);
+            return i >= 0 ? &inline_bindings[i] : nullptr;
         }
+        auto it = table.find(name);
+        return it != table.end() ? &it->second : nullptr;
     }
     
-    bool check(ProgramNode* program) {
-        // PHASE 1: Global declarations
-        for (auto& var : program->globals) {
-            if (!global->add(var.name, var.type)) {
-                error(ScopeError::VariableRedefined, var.name);
-            }
-        }
-        
-        for (auto& func : program->functions) {
-            if (!global->add(func.name, "function")) {
-                error(ScopeError::FunctionRedefined, func.name);
-            }
-        }
-        
-        // PHASE 2: Function bodies
-        for (auto& func : program->functions) {
-            check_function(&func);
-        }
-        
-        // PHASE 3: Global initializers
-        for (auto& var : program->globals) {
-            if (var.value) check_node(var.value.get());
+    size_t size() const { return count; }
+    
+    // Bytes of this scope and its function table, with an estimate for
+    // the nodes of a spilled hash table.
+    size_t memory_bytes() const {
+        return sizeof(Scope) + table.bucket_count() * sizeof(void*)
+             + table.size() * (sizeof(std::pair<const Symbol, Binding>) + sizeof(void*))
+             + function_table.memory_bytes();
+    }
+    
+    // Calls f(name, binding) for every declaration of this scope.
+    template<typename F>
+    void for_each(F&& f) const {
+        if (!spilled) {
+            for (uint32_t i = 0; i < count; ++i) f(Symbol::from_id(inline_ids[i]), inline_bindings[i]);
+        } else {
+            for (auto& entry : table) f(entry.first, entry.second);
         }
-        
-        return errors.empty();
     }
     
-    const std::vector<ScopeError>& getErrors() const { return errors; }
-    bool passed() const { return errors.empty(); }
-    size_t errorCount() const { return errors.size(); }
+    // Removes all declarations, functions included; a spilled table keeps
+    // its buckets.
+    void clear() {
+        table.clear();
+        count = 0;
+        spilled = false;
+        function_table.clear();
+    }
 
 private:
+    uint32_t inline_ids[kInlineCapacity];
+    Binding inline_bindings[kInlineCapacity];
+    uint32_t count = 0;
+    bool spilled = false;
+    std::unordered_map<Symbol, Binding> table;
+    FunctionTable function_table;
+    
+    int find_inline(Symbol name) const {
+        return find_symbol_id(inline_ids, count, name.id);
+    }
+    
+    void spill() {
+        table.reserve(kInlineCapacity * 2);
+        for (uint32_t i = 0; i < count; ++i) table.emplace(Symbol::from_id(inline_ids[i]), inline_bindings[i]);
+        spilled = true;
+    }
+};
+
+// Checks function bodies and initializers against an already populated
+// global scope. A walker only writes to its own scope stack and error
+// buffer, so one walker per thread can share a read-only global scope.
+//
+// While checking, every NameNode and AssignmentNode gets `decl` set to the
+// declaration it resolves to and every CallNode gets `callee`; both are null
+// when resolution fails. Later passes can use these instead of repeating
+// the lookups, as long as the program (including its globals and params
+// vectors) is not modified in between.
+//
+// Policy (see analyzer_policy.h) fixes the diagnostic sink, shadowing rule
+// and scope model at compile time. Under VerdictOnly `errors` stays empty
+// and limit_reached() tells whether the last traversal found an error.
+template<typename Policy>
+class BasicScopeWalker {
+public:
+    std::vector<Diagnostic> errors;
+    AnalyzerStats stats;   // only counted with SCOPE_ANALYZER_STATS
+    
+    // `initializer_scope` receives declarations made outside any function
+    // (phase 3); it is null while checking function bodies.
+    BasicScopeWalker(const Scope& g, Scope* initializer_scope = nullptr)
+        : global(g), global_decls(initializer_scope) {}
+    
+    // When set, every name looked up in the global scope is appended to
+    // `out`: exactly the globals the checked code depends on.
+    void track_global_refs(std::vector<Symbol>* out) { global_refs = out; }
+    
+    // Stops the current and later traversals once `errors` holds max
+    // entries; 0 removes the limit. Scopes left open by an interrupted
+    // traversal are closed.
+    void limit_errors(size_t max) {
+        max_errors = max;
+        stopped = false;
+    }
+    
+    bool limit_reached() const { return stopped; }
+    
+    size_t peak_scope_depth() const { return locals.peak_depth(); }
+    
+    // Bytes of the scope stack and traversal buffers, at their largest so far.
+    size_t memory_bytes() const {
+        return locals.memory_bytes() + work.capacity() * sizeof(Task) + errors.capacity() * sizeof(Diagnostic);
+    }
+    
     void check_function(FunctionNode* func) {
+        ANALYZER_STAT(++stats.nodes[(size_t)NodeKind::Function]);
+        ANALYZER_STAT(stats.nodes[(size_t)NodeKind::Variable] += func->params.size());
         enter_scope();
         
         for (auto& param : func->params) {
-            if (!current->add(param.name, param.type)) {
-                error(ScopeError::VariableRedefined, param.name);
+            if (!locals.add(param.name, param.type, &param)) {
+                error(ScopeError::VariableRedefined, param.name, param.loc);
             }
         }
         
-        if (func->body) check_node(func->body.get());
+        if (func->body && !stopped) check_node(func->body);
         
         leave_scope();
     }
     
-    void check_node(ASTNode* node) {
-        if (!node) return;
+    // Checks statements [begin, end) of func's body block, one piece of a
+    // function split across workers. The parameters and the body's own
+    // declarations before `begin` are declared again first, without being
+    // checked, so the piece sees the scope check_function would give it;
+    // only the piece starting at 0 reports parameter redefinitions.
+    void check_function_part(FunctionNode* func, size_t begin, size_t end) {
+        auto& stmts = static_cast<BlockNode*>(func->body)->statements;
+        if (begin == 0) {
+            ANALYZER_STAT(++stats.nodes[(size_t)NodeKind::Function]);
+            ANALYZER_STAT(stats.nodes[(size_t)NodeKind::Variable] += func->params.size());
+            ANALYZER_STAT(++stats.nodes[(size_t)NodeKind::Block]);
+        }
+        enter_scope();
+        for (auto& param : func->params) {
+            if (!locals.add(param.name, param.type, &param) && begin == 0) {
+                error(ScopeError::VariableRedefined, param.name, param.loc);
+            }
+        }
         
-        if (auto block = dynamic_cast<BlockNode*>(node)) {
-            enter_scope();
-            for (auto& stmt : block->statements) {
-                check_node(stmt.get());
+        enter_scope();
+        for (size_t i = 0; i < begin; ++i) {
+            ASTNode* stmt = stmts[i];
+            if constexpr (!Policy::for_scope) {
+                // Loop initializers belong to the body scope too.
+                if (stmt && stmt->kind() == NodeKind::For) stmt = static_cast<ForNode*>(stmt)->initializer;
             }
-            leave_scope();
+            if (!stmt || stmt->kind() != NodeKind::Variable) continue;
+            auto var = static_cast<const VariableNode*>(stmt);
+            if (!Policy::shadowing && locals.resolve(var->name)) continue;
+            locals.add(var->name, var->type, var);
         }
-        else if (auto var = dynamic_cast<VariableNode*>(node)) {
-            if (current->in_scope(var->name)) {
-                error(ScopeError::VariableRedefined, var->name);
-            } else {
-                current->add(var->name, var->type);
+        for (size_t i = begin; i < end && !stopped; ++i) check_node(stmts[i]);
+        leave_scope();
+        
+        leave_scope();
+    }
+    
+    // Traverses the subtree with an explicit work stack instead of
+    // recursion, so arbitrarily deep trees (long operator chains, deeply
+    // nested blocks) need no call-stack space. The first child of a node is
+    // visited directly and the rest are pushed in reverse, so nodes are
+    // visited, and errors reported, in source order.
+    void check_node(ASTNode* root) {
+        if (stopped) return;
+        work.clear();
+        size_t depth = locals.depth();
+        ASTNode* node = root;
+        
+        for (;;) {
+            while (node && !stopped) node = step(node);
+            if (stopped) {
+                while (locals.depth() > depth) leave_scope();
+                break;
+            }
+            if (work.empty()) break;
+            
+            Task task = work.back();
+            work.pop_back();
+            switch (task.step) {
+                case Step::Visit:
+                    node = task.node;
+                    break;
+                case Step::LeaveScope:
+                    leave_scope();
+                    break;
+                case Step::ResolveAssignment: {
+                    auto assign = static_cast<AssignmentNode*>(task.node);
+                    assign->decl = resolve(assign->name);
+                    if (!assign->decl) {
+                        error(ScopeError::UndeclaredVariable, assign->name, assign->loc);
+                    }
+                    break;
+                }
             }
-            if (var->value) check_node(var->value.get());
         }
-        else if (auto call = dynamic_cast<CallNode*>(node)) {
-            if (global->find(call->name) != "function") {
-                error(ScopeError::UndefinedFunction, call->name);
+    }
+
+private:
+    const Scope& global;
+    Scope* global_decls;
+    std::vector<Symbol>* global_refs = nullptr;
+    size_t max_errors = 0;
+    bool stopped = false;
+    ScopeStack locals;
+    
+    enum class Step : uint8_t { Visit, LeaveScope, ResolveAssignment };
+    struct Task {
+        Step step;
+        ASTNode* node;
+    };
+    std::vector<Task> work;
+    
+    // Literals have nothing to resolve and are never queued.
+    void visit(ASTNode* node) {
+        if (node && node->kind() != NodeKind::Literal) work.push_back({Step::Visit, node});
+    }
+    
+    // Checks one node, queues all but its first child and returns that
+    // child (or null) for the caller to continue with.
+    ASTNode* step(ASTNode* node) {
+        ANALYZER_STAT(++stats.nodes[(size_t)node->kind()]);
+        switch (node->kind()) {
+            case NodeKind::Block: {
+                auto block = static_cast<BlockNode*>(node);
+                enter_scope();
+                work.push_back({Step::LeaveScope, nullptr});
+                auto& stmts = block->statements;
+                if (stmts.empty()) return nullptr;
+                for (size_t i = stmts.size() - 1; i > 0; --i) visit(stmts[i]);
+                return stmts[0];
             }
-            for (auto& arg : call->args) {
-                check_node(arg.get());
+            case NodeKind::Variable: {
+                auto var = static_cast<VariableNode*>(node);
+                if (redefines(var->name)) {
+                    error(ScopeError::VariableRedefined, var->name, var->loc);
+                } else {
+                    declare(var);
+                }
+                return var->value;
+            }
+            case NodeKind::Call: {
+                auto call = static_cast<CallNode*>(node);
+                if (global_refs) global_refs->push_back(call->name);
+                FunctionSignature callee = global.find_function(call->name);
+                if (callee) {
+                    call->callee = callee.decl;
+                } else {
+                    call->callee = nullptr;
+                    error(ScopeError::UndefinedFunction, call->name, call->loc);
+                }
+                auto& args = call->args;
+                if (args.empty()) return nullptr;
+                for (size_t i = args.size() - 1; i > 0; --i) visit(args[i]);
+                return args[0];
+            }
+            case NodeKind::Name: {
+                auto name = static_cast<NameNode*>(node);
+                name->decl = resolve(name->name);
+                if (!name->decl) {
+                    error(ScopeError::UndeclaredVariable, name->name, name->loc);
+                }
+                return nullptr;
+            }
+            case NodeKind::Assignment: {
+                // The value is checked before the target is resolved.
+                auto assign = static_cast<AssignmentNode*>(node);
+                work.push_back({Step::ResolveAssignment, assign});
+                return assign->value;
+            }
+            case NodeKind::Return:
+                return static_cast<ReturnNode*>(node)->value;
+            case NodeKind::If: {
+                auto if_stmt = static_cast<IfNode*>(node);
+                visit(if_stmt->else_branch);
+                visit(if_stmt->then_branch);
+                return if_stmt->condition;
+            }
+            case NodeKind::While: {
+                auto while_stmt = static_cast<WhileNode*>(node);
+                visit(while_stmt->body);
+                return while_stmt->condition;
+            }
+            case NodeKind::For: {
+                auto for_stmt = static_cast<ForNode*>(node);
+                if constexpr (Policy::for_scope) {
+                    enter_scope();
+                    work.push_back({Step::LeaveScope, nullptr});
+                }
+                visit(for_stmt->body);
+                visit(for_stmt->increment);
+                visit(for_stmt->condition);
+                return for_stmt->initializer;
+            }
+            case NodeKind::BinaryOp: {
+                auto binary = static_cast<BinaryOpNode*>(node);
+                visit(binary->right);
+                return binary->left;
+            }
+            case NodeKind::Literal:
+                // LiteralNode doesn't need checking - always valid
+                return nullptr;
+            case NodeKind::Function:
+            case NodeKind::Program:
+                // Only reachable through check()/check_function()
+                return nullptr;
+        }
+        return nullptr;
+    }
+    
+    void error(ScopeError err, Symbol name, SourceLocation loc) {
+        if constexpr (Policy::records) {
+            errors.push_back({err, name, loc});
+            if (max_errors && errors.size() >= max_errors) stopped = true;
+        } else {
+            (void)err, (void)name, (void)loc;
+            stopped = true;
+        }
+    }
+    
+    void enter_scope() {
+        locals.push();
+        ANALYZER_STAT(++stats.scopes_entered);
+        ANALYZER_STAT(stats.peak_scope_depth = std::max(stats.peak_scope_depth, (uint32_t)locals.depth()));
+    }
+    void leave_scope() { locals.pop(); }
+    
+    // Whether declaring name here is a redefinition under the policy.
+    bool redefines(Symbol name) const {
+        if (locals.empty()) return global_decls->in_scope(name);
+        if constexpr (Policy::shadowing) return locals.in_scope(name);
+        else return locals.resolve(name) != nullptr;
+    }
+    
+    void declare(const VariableNode* var) {
+        if (locals.empty()) global_decls->add(var->name, var->type, var);
+        else locals.add(var->name, var->type, var);
+    }
+    
+    const Binding* lookup_global(Symbol name) {
+#if SCOPE_ANALYZER_STATS
+        ++stats.global_lookups;
+        return global.resolve(name, stats.scopes_walked);
+#else
+        return global.resolve(name);
+#endif
+    }
+    
+    // Declaration name refers to, looking through the locals first.
+    const ASTNode* resolve(Symbol name) {
+        const Binding* b = locals.resolve(name);
+        if (!b) {
+            if (global_refs) global_refs->push_back(name);
+            b = lookup_global(name);
+        }
+        return b ? b->decl : nullptr;
+    }
+};
+
+using ScopeWalker = BasicScopeWalker<DefaultPolicy>;
+
+// PHASE 1 of the analysis: declares every global variable and then every
+// function of program in `global`, reporting redefinitions. Variables and
+// functions are separate namespaces and do not clash with each other.
+inline void declare_globals(ProgramNode* program, Scope& global, std::vector<Diagnostic>& errors) {
+    size_t params = 0;
+    for (auto& func : program->functions) params += func.params.size();
+    global.reserve_functions(program->functions.size(), params);
+    for (auto& var : program->globals) {
+        if (!global.add(var.name, var.type, &var)) {
+            errors.push_back({ScopeError::VariableRedefined, var.name, var.loc});
+        }
+    }
+    
+    for (auto& func : program->functions) {
+        if (!global.add_function(func)) {
+            errors.push_back({ScopeError::FunctionRedefined, func.name, func.loc});
+        }
+    }
+}
+
+// Scope checker for a whole program. Diagnostics are recorded in
+// source order and never printed; use DiagnosticReporter to format them.
+// Policy is as for BasicScopeWalker; with VerdictOnly the analyzer keeps
+// no diagnostics whatever the options say, and getErrors() stays empty.
+// Type errors are still collected by the TypeChecker, and dropped.
+template<typename Policy>
+class BasicScopeAnalyzer {
+    using Walker = BasicScopeWalker<Policy>;
+    
+    AnalyzerOptions options;
+    std::vector<Diagnostic> errors;
+    std::vector<TypeDiagnostic> type_errors;
+    Scope global;
+    AnalyzerStats stats;
+    AnalyzerMemory memory;
+    size_t limit = 0;
+    bool failed = false;
+    
+    size_t found() const { return errors.size() + type_errors.size(); }
+    bool limit_reached() const {
+        if constexpr (Policy::records) return limit && found() >= limit;
+        else return failed;
+    }
+    // Diagnostics still allowed by the limit.
+    size_t remaining() const { return limit ? limit - std::min(limit, found()) : 0; }
+    
+    // Appends one unit's scope errors, then its type errors, up to the limit.
+    void take(std::vector<Diagnostic>& scope, std::vector<TypeDiagnostic>& types) {
+        size_t n = limit ? std::min(scope.size(), remaining()) : scope.size();
+        errors.insert(errors.end(), scope.begin(), scope.begin() + n);
+        n = limit ? std::min(types.size(), remaining()) : types.size();
+        type_errors.insert(type_errors.end(), types.begin(), types.begin() + n);
+        scope.clear();
+        types.clear();
+    }
+    
+    void take_errors(Walker& walker, TypeChecker& types) {
+        if constexpr (Policy::records) {
+            take(walker.errors, types.errors);
+        } else {
+            failed = failed || walker.limit_reached() || !types.errors.empty();
+            types.errors.clear();
+        }
+    }
+    
+    void note_memory(const Walker& walker) {
+        memory.walker_bytes += walker.memory_bytes();
+        memory.peak_scopes = std::max(memory.peak_scopes, (uint32_t)walker.peak_scope_depth());
+    }
+    
+public:
+    explicit BasicScopeAnalyzer(const AnalyzerOptions& opts = AnalyzerOptions()) : options(opts) {}
+    
+    // Layers the program's global scope on top of `prelude`, which holds
+    // library declarations shared by many programs. Names declared by the
+    // program shadow prelude names. The prelude is only read and must
+    // outlive the analyzer.
+    BasicScopeAnalyzer(const Scope& prelude, const AnalyzerOptions& opts = AnalyzerOptions())
+        : options(opts), global(&prelude) {}
+    
+    // With an error limit, analysis ends once the limit is reached; the
+    // units after that point are not checked and get no resolution links.
+    bool check(ProgramNode* program) {
+        auto check_start = stats_clock();
+        limit = options.error_limit();
+        memory = AnalyzerMemory();
+        
+        // PHASE 1: Global declarations
+        {
+            PhaseTimer timer(stats, AnalyzerPhase::Declarations, check_start);
+            declare_globals(program, global, errors);
+            if constexpr (!Policy::records) {
+                failed = failed || !errors.empty();
+                errors.clear();
+            } else if (limit_reached()) {
+                errors.resize(limit);
             }
         }
-        else if (auto name = dynamic_cast<NameNode*>(node)) {
-            if (current->find(name->name).empty()) {
-                error(ScopeError::UndeclaredVariable, name->name);
+        
+        // PHASE 2: Function bodies
+        if (!limit_reached()) {
+            PhaseTimer timer(stats, AnalyzerPhase::Bodies, check_start);
+            if (resolve_thread_count(options.threads) > 1) {
+                if constexpr (Policy::records) check_functions_parallel(program);
+                else check_functions_verdict(program);
+            } else {
+                Walker walker(global);
+                TypeChecker types;
+                for (auto& func : program->functions) {
+                    if (limit_reached()) break;
+                    walker.limit_errors(remaining());
+                    walker.check_function(&func);
+                    if (options.check_types) types.check_function(&func);
+                    take_errors(walker, types);
+                }
+                ANALYZER_STAT(stats.merge(walker.stats));
+                note_memory(walker);
             }
         }
-        else if (auto assign = dynamic_cast<AssignmentNode*>(node)) {
-            check_node(assign->value.get());
-            if (current->find(assign->name).empty()) {
-                error(ScopeError::UndeclaredVariable, assign->name);
+        
+        // PHASE 3: Global initializers
+        if (!limit_reached()) {
+            PhaseTimer timer(stats, AnalyzerPhase::Initializers, check_start);
+            Walker walker(global, &global);
+            TypeChecker types;
+            for (auto& var : program->globals) {
+                if (!var.value) continue;
+                if (limit_reached()) break;
+                walker.limit_errors(remaining());
+                walker.check_node(var.value);
+                if (options.check_types) types.check_global(&var);
+                take_errors(walker, types);
             }
+            ANALYZER_STAT(stats.merge(walker.stats));
+            note_memory(walker);
         }
-        else if (auto ret = dynamic_cast<ReturnNode*>(node)) {
-            if (ret->value) check_node(ret->value.get());
+        memory.global_scope_bytes = global.memory_bytes();
+        
+        if (Policy::records && options.verdict_only) {
+            failed = found() != 0;
+            errors.clear();
+            type_errors.clear();
         }
-        else if (auto if_stmt = dynamic_cast<IfNode*>(node)) {
-            check_node(if_stmt->condition.get());
-            check_node(if_stmt->then_branch.get());
-            if (if_stmt->else_branch) check_node(if_stmt->else_branch.get());
+        return passed();
+    }
+    
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+    const std::vector<TypeDiagnostic>& getTypeErrors() const { return type_errors; }
+    bool passed() const { return !failed && errors.empty() && type_errors.empty(); }
+    size_t errorCount() const { return errors.size(); }
+    
+    // Counters of the last check(); all zero unless built with
+    // SCOPE_ANALYZER_STATS.
+    const AnalyzerStats& getStats() const { return stats; }
+    
+    // Scope memory of the last check(); collected in every build.
+    const AnalyzerMemory& getMemory() const { return memory; }
+    
+    // Declarations of the last checked program, layered on the prelude.
+    const Scope& getGlobalScope() const { return global; }
+    
+    // Forgets the last program's results so the analyzer, and the memory
+    // of its global scope, can be reused for the next one.
+    void reset() {
+        errors.clear();
+        type_errors.clear();
+        global.clear();
+        stats = AnalyzerStats();
+        memory = AnalyzerMemory();
+        failed = false;
+    }
+    
+    // Moves the results out, leaving the analyzer ready for reset().
+    std::vector<Diagnostic> takeErrors() { return std::move(errors); }
+    std::vector<TypeDiagnostic> takeTypeErrors() { return std::move(type_errors); }
+
+private:
+    // Piece of phase 2 for one worker: a whole function, or statements
+    // [begin, end) of the body block of a function split into parts
+    // first..last (indices into the part list).
+    struct Part {
+        uint32_t function;
+        uint32_t begin, end;
+        uint32_t first, last;
+        bool whole;
+    };
+    
+    // Splits functions whose body block has many statements, so that a
+    // few huge functions do not leave one worker with most of the work.
+    // Statement counts stand in for sizes since they are known without a
+    // traversal; a part holds about 1/(8 * workers) of them.
+    static std::vector<Part> plan_parts(const std::vector<FunctionNode>& functions, unsigned workers) {
+        const size_t kMinPart = 16;
+        auto split_size = [](const FunctionNode& func) -> size_t {
+            if (!func.body || func.body->kind() != NodeKind::Block) return 1;
+            return std::max<size_t>(1, static_cast<const BlockNode*>(func.body)->statements.size());
+        };
+        size_t total = 0;
+        for (auto& func : functions) total += split_size(func);
+        size_t target = std::max(kMinPart, total / (8 * (size_t)workers));
+        
+        std::vector<Part> parts;
+        parts.reserve(functions.size());
+        for (uint32_t f = 0; f < functions.size(); ++f) {
+            size_t n = split_size(functions[f]);
+            uint32_t first = (uint32_t)parts.size();
+            if (n < 2 * target) {
+                parts.push_back({f, 0, 0, first, first, true});
+                continue;
+            }
+            size_t count = (n + target - 1) / target;
+            for (size_t k = 0; k < count; ++k) {
+                parts.push_back({f, (uint32_t)(n * k / count), (uint32_t)(n * (k + 1) / count), first, 0, false});
+            }
+            for (uint32_t q = first; q < parts.size(); ++q) parts[q].last = (uint32_t)parts.size() - 1;
         }
-        else if (auto while_stmt = dynamic_cast<WhileNode*>(node)) {
-            check_node(while_stmt->condition.get());
-            check_node(while_stmt->body.get());
+        return parts;
+    }
+    
+    // Bodies only read the global scope after phase 1, so each worker gets
+    // its own walker. Errors are buffered per part and merged in source
+    // order, a split function's scope errors before its type errors, so
+    // the result is independent of scheduling. Parts are handed out one at
+    // a time by parallel_for; with no part much larger than the others
+    // that keeps every worker busy until the end. The worker finishing the
+    // last outstanding part of a split function reports its missing
+    // return, if any.
+    //
+    // With an error limit, finished functions are counted in source order
+    // as the prefix of done functions grows. Once that prefix holds enough
+    // diagnostics, `cutoff` is set to the last part of its last function
+    // and the workers skip every later part, so the merged result is the
+    // same as in a sequential run.
+    void check_functions_parallel(ProgramNode* program) {
+        auto& functions = program->functions;
+        unsigned workers = resolve_thread_count(options.threads);
+        std::vector<Part> parts = plan_parts(functions, workers);
+        std::vector<Walker> walkers(workers, Walker(global));
+        std::vector<TypeChecker> checkers(workers);
+        std::vector<std::vector<Diagnostic>> results(parts.size());
+        std::vector<std::vector<TypeDiagnostic>> type_results(parts.size());
+        std::vector<std::atomic<uint32_t>> pending(functions.size());
+        std::vector<std::atomic<bool>> returns(functions.size());
+        for (auto& part : parts) {
+            if (!part.whole) pending[part.function].fetch_add(1, std::memory_order_relaxed);
         }
-        else if (auto for_stmt = dynamic_cast<ForNode*>(node)) {
-            enter_scope();
-            if (for_stmt->initializer) check_node(for_stmt->initializer.get());
-            if (for_stmt->condition) check_node(for_stmt->condition.get());
-            if (for_stmt->increment) check_node(for_stmt->increment.get());
-            if (for_stmt->body) check_node(for_stmt->body.get());
-            leave_scope();
+        
+        size_t budget = remaining();
+        std::atomic<size_t> cutoff{SIZE_MAX};
+        std::mutex prefix_mutex;
+        std::vector<uint8_t> done(limit ? parts.size() : 0);
+        size_t prefix_end = 0, prefix_errors = 0;
+        
+        parallel_for(parts.size(), workers, [&](unsigned worker, size_t p) {
+            if (p > cutoff.load(std::memory_order_relaxed)) return;
+            const Part& part = parts[p];
+            FunctionNode* func = &functions[part.function];
+            Walker& walker = walkers[worker];
+            TypeChecker& types = checkers[worker];
+            walker.limit_errors(budget);
+            if (part.whole) {
+                walker.check_function(func);
+                if (options.check_types) types.check_function(func);
+            } else {
+                walker.check_function_part(func, part.begin, part.end);
+                if (options.check_types && types.check_function_part(func, part.begin, part.end)) {
+                    returns[part.function].store(true, std::memory_order_relaxed);
+                }
+            }
+            results[p].swap(walker.errors);
+            type_results[p].swap(types.errors);
+            if (!part.whole) {
+                if (pending[part.function].fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+                if (options.check_types) {
+                    types.check_return_found(func, returns[part.function].load(std::memory_order_relaxed));
+                    auto& last = type_results[part.last];
+                    last.insert(last.end(), types.errors.begin(), types.errors.end());
+                    types.errors.clear();
+                }
+            }
+            if (!limit) return;
+            
+            std::lock_guard<std::mutex> lock(prefix_mutex);
+            for (uint32_t q = part.first; q <= part.last; ++q) done[q] = 1;
+            while (prefix_end < parts.size() && done[prefix_end]) {
+                uint32_t last = parts[prefix_end].last;
+                for (uint32_t q = prefix_end; q <= last; ++q) prefix_errors += results[q].size() + type_results[q].size();
+                if (prefix_errors >= budget) {
+                    cutoff.store(last, std::memory_order_relaxed);
+                    prefix_end = parts.size();
+                    break;
+                }
+                prefix_end = last + 1;
+            }
+        });
+        
+        std::vector<Diagnostic> no_errors;
+        std::vector<TypeDiagnostic> no_type_errors;
+        for (size_t p = 0; p < parts.size() && p <= cutoff.load(); p = parts[p].last + 1) {
+            for (uint32_t q = parts[p].first; q <= parts[p].last; ++q) take(results[q], no_type_errors);
+            for (uint32_t q = parts[p].first; q <= parts[p].last; ++q) take(no_errors, type_results[q]);
         }
-        else if (auto binary = dynamic_cast<BinaryOpNode*>(node)) {
-            check_node(binary->left.get());
-            check_node(binary->right.get());
+        for (auto& walker : walkers) note_memory(walker);
+#if SCOPE_ANALYZER_STATS
+        for (auto& walker : walkers) stats.merge(walker.stats);
+#endif
+    }
+    
+    // Phase 2 without diagnostics: any failure decides the verdict, so
+    // parts run in whatever order parallel_for hands them out and all
+    // workers stop taking parts once one of them has failed.
+    void check_functions_verdict(ProgramNode* program) {
+        auto& functions = program->functions;
+        unsigned workers = resolve_thread_count(options.threads);
+        std::vector<Part> parts = plan_parts(functions, workers);
+        std::vector<Walker> walkers(workers, Walker(global));
+        std::vector<TypeChecker> checkers(workers);
+        std::vector<std::atomic<uint32_t>> pending(functions.size());
+        std::vector<std::atomic<bool>> returns(functions.size());
+        for (auto& part : parts) {
+            if (!part.whole) pending[part.function].fetch_add(1, std::memory_order_relaxed);
         }
-        // LiteralNode doesn't need checking - always valid
+        std::atomic<bool> any_failed{false};
+        
+        parallel_for(parts.size(), workers, [&](unsigned worker, size_t p) {
+            if (any_failed.load(std::memory_order_relaxed)) return;
+            const Part& part = parts[p];
+            FunctionNode* func = &functions[part.function];
+            Walker& walker = walkers[worker];
+            TypeChecker& types = checkers[worker];
+            walker.limit_errors(1);
+            if (part.whole) {
+                walker.check_function(func);
+                if (options.check_types) types.check_function(func);
+            } else {
+                walker.check_function_part(func, part.begin, part.end);
+                if (options.check_types && types.check_function_part(func, part.begin, part.end)) {
+                    returns[part.function].store(true, std::memory_order_relaxed);
+                }
+                if (options.check_types && pending[part.function].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    types.check_return_found(func, returns[part.function].load(std::memory_order_relaxed));
+                }
+            }
+            if (walker.limit_reached() || !types.errors.empty()) any_failed.store(true, std::memory_order_relaxed);
+            types.errors.clear();
+        });
+        
+        failed = failed || any_failed.load();
+        for (auto& walker : walkers) note_memory(walker);
+#if SCOPE_ANALYZER_STATS
+        for (auto& walker : walkers) stats.merge(walker.stats);
+#endif
     }
 };
 
+using ScopeAnalyzer = BasicScopeAnalyzer<DefaultPolicy>;
+
+// Verdict-only analysis compiled without any diagnostic recording.
+using VerdictAnalyzer = BasicScopeAnalyzer<VerdictPolicy>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+// Resident analyzer for editor-on-save checks; see analysis_server.h.
+//
+//   g++ -std=c++17 -O2 -pthread scope_server.cpp -o scope_server
+//   ./scope_server --socket=/tmp/scope.sock --prelude=lib.ast --check-types=1
+//   ./scope_server --socket=/tmp/scope.sock --request="check unit.ast"
+//
+// Program files are written with write_program (benchmark --flat
+// --dump=PATH produces one). With --request the binary acts as a client:
+// it sends the one request and prints the response.
+#include "analysis_server.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct ServerOptions {
+    AnalyzerOptions analyzer;
+    std::string socket;
+    std::vector<std::string> preludes;
+    std::string request;
+};
+
+bool parse_option(const char* arg, const char* name, std::string& value) {
+    size_t len = std::strlen(name);
+    if (std::strncmp(arg, "--", 2) != 0 || std::strncmp(arg + 2, name, len) != 0 || arg[2 + len] != '=') {
+        return false;
+    }
+    value = arg + 3 + len;
+    return true;
+}
+
+// A boolean option: --name alone means --name=1.
+bool parse_flag(const char* arg, const char* name, std::string& value) {
+    if (std::strncmp(arg, "--", 2) == 0 && std::strcmp(arg + 2, name) == 0) {
+        value = "1";
+        return true;
+    }
+    return parse_option(arg, name, value);
+}
+
+bool parse_args(int argc, char** argv, ServerOptions& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string v;
+        if (parse_option(argv[i], "socket", v)) opts.socket = v;
+        else if (parse_option(argv[i], "prelude", v)) opts.preludes.push_back(v);
+        else if (parse_option(argv[i], "request", v)) opts.request = v;
+        else if (parse_option(argv[i], "threads", v)) opts.analyzer.threads = (unsigned)std::stoul(v);
+        else if (parse_flag(argv[i], "check-types", v)) opts.analyzer.check_types = v != "0";
+        else if (parse_option(argv[i], "max-errors", v)) opts.analyzer.max_errors = std::stoul(v);
+        else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    if (opts.socket.empty()) {
+        std::cerr << "--socket=PATH is required" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    ServerOptions opts;
+    if (!parse_args(argc, argv, opts)) return 2;
+    std::string error;
+
+    if (!opts.request.empty()) {
+        std::string response;
+        if (!send_request(opts.socket, opts.request, &response, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::cout << response << std::flush;
+        return 0;
+    }
+
+    AnalysisServer server(opts.analyzer);
+    for (auto& path : opts.preludes) {
+        if (!server.add_prelude(path, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    DiagnosticReporter().report(std::cerr, server.getPreludeErrors());
+    if (!server.serve(opts.socket, &error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
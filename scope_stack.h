@@ -0,0 +1,101 @@
+#ifndef SCOPE_STACK_H
+#define SCOPE_STACK_H
+
+#include "parse_tree.h"
+#include "symbol.h"
+#include <cstdint>
+#include <vector>
+
+// What a variable name is bound to: its declared type and the declaring
+// VariableNode, when there is one. Functions live in a FunctionTable.
+struct Binding {
+    Symbol type;
+    const ASTNode* decl = nullptr;
+};
+
+// Stack of nested local scopes sharing one storage, in the style of LLVM's
+// ScopedHashTable. Declarations live in a single vector with a start marker
+// per open scope; for every name, `head` points at its innermost visible
+// declaration and each entry links to the one it shadows. Entering and
+// leaving a scope never allocates once the vectors have warmed up, and a
+// lookup is a single indexed load since Symbol ids are dense.
+class ScopeStack {
+    struct Entry {
+        Symbol name;
+        Binding binding;
+        int32_t shadowed;   // previous visible entry for the same name, or -1
+    };
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> scope_starts;
+    std::vector<int32_t> head;   // indexed by Symbol::id, -1 when not declared
+    size_t peak = 0;
+
+    int32_t lookup(Symbol name) const {
+        return name.id < head.size() ? head[name.id] : -1;
+    }
+
+public:
+    void push() {
+        scope_starts.push_back((uint32_t)entries.size());
+        if (scope_starts.size() > peak) peak = scope_starts.size();
+    }
+
+    void pop() {
+        uint32_t start = scope_starts.back();
+        scope_starts.pop_back();
+        while (entries.size() > start) {
+            const Entry& e = entries.back();
+            head[e.name.id] = e.shadowed;
+            entries.pop_back();
+        }
+    }
+
+    bool empty() const { return scope_starts.empty(); }
+    size_t depth() const { return scope_starts.size(); }
+
+    // Declares name in the innermost scope; fails if it is already declared
+    // there. Requires an open scope.
+    bool add(Symbol name, Symbol type, const ASTNode* decl = nullptr) {
+        if (in_scope(name)) return false;
+        if (name.id >= head.size()) {
+            size_t size = head.size() * 2;
+            if (size <= name.id) size = name.id + 1;
+            head.resize(size, -1);
+        }
+        entries.push_back({name, {type, decl}, head[name.id]});
+        head[name.id] = (int32_t)entries.size() - 1;
+        return true;
+    }
+
+    bool in_scope(Symbol name) const {
+        int32_t i = lookup(name);
+        return i >= 0 && (uint32_t)i >= scope_starts.back();
+    }
+
+    // Returns the type of the innermost visible declaration, or an empty
+    // Symbol if name is not declared in any open scope.
+    Symbol find(Symbol name) const {
+        int32_t i = lookup(name);
+        return i >= 0 ? entries[i].binding.type : Symbol();
+    }
+
+    // Innermost visible binding of name, or null.
+    const Binding* resolve(Symbol name) const {
+        int32_t i = lookup(name);
+        return i >= 0 ? &entries[i].binding : nullptr;
+    }
+
+    void clear() {
+        while (!empty()) pop();
+    }
+    
+    // Most scopes open at once so far.
+    size_t peak_depth() const { return peak; }
+    
+    size_t memory_bytes() const {
+        return entries.capacity() * sizeof(Entry) + (scope_starts.capacity() + head.capacity()) * sizeof(uint32_t);
+    }
+};
+
+#endif
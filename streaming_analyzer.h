@@ -0,0 +1,126 @@
+#ifndef STREAMING_ANALYZER_H
+#define STREAMING_ANALYZER_H
+
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+// ScopeAnalyzer for programs that arrive piece by piece, so a unit never
+// has to be in memory as a whole:
+//
+//   StreamingAnalyzer analyzer;
+//   for each global:   analyzer.declare_global(&var);
+//   for each function: analyzer.declare_function(signature);
+//   for each function: analyzer.check_body(&func);  // then free its nodes
+//   analyzer.finish();
+//
+// All declarations must come before the first body. Function signatures
+// are copied, so the analyzer owns everything resolution links point to:
+// a body, and the arena holding it, can be released as soon as
+// check_body() returns. Globals are referenced, not copied; they and
+// their initializers must stay alive until finish(). Diagnostics come
+// out in the same order as from ScopeAnalyzer::check on the whole
+// program. Bodies are checked on the calling thread; options.threads is
+// ignored.
+class StreamingAnalyzer {
+    AnalyzerOptions options;
+    Scope global;
+    std::deque<FunctionNode> signatures;
+    std::vector<VariableNode*> globals;
+    std::vector<Diagnostic> errors;
+    std::vector<TypeDiagnostic> type_errors;
+    ScopeWalker walker;
+    TypeChecker types;
+    size_t limit;
+    bool failed = false;
+
+    size_t found() const { return errors.size() + type_errors.size(); }
+    bool limit_reached() const { return limit && found() >= limit; }
+    size_t remaining() const { return limit ? limit - std::min(limit, found()) : 0; }
+
+    // Appends a unit's scope errors, then its type errors, up to the limit.
+    void take(std::vector<Diagnostic>& scope) {
+        size_t n = limit ? std::min(scope.size(), remaining()) : scope.size();
+        errors.insert(errors.end(), scope.begin(), scope.begin() + n);
+        n = limit ? std::min(types.errors.size(), remaining()) : types.errors.size();
+        type_errors.insert(type_errors.end(), types.errors.begin(), types.errors.begin() + n);
+        scope.clear();
+        types.errors.clear();
+    }
+
+    void declaration_error(ScopeError kind, Symbol name, SourceLocation loc) {
+        if (!limit_reached()) errors.push_back({kind, name, loc});
+    }
+
+public:
+    explicit StreamingAnalyzer(const AnalyzerOptions& opts = AnalyzerOptions())
+        : options(opts), walker(global), limit(opts.error_limit()) {}
+
+    // Layers the program's globals on a shared prelude, as ScopeAnalyzer.
+    StreamingAnalyzer(const Scope& prelude, const AnalyzerOptions& opts = AnalyzerOptions())
+        : options(opts), global(&prelude), walker(global), limit(opts.error_limit()) {}
+
+    StreamingAnalyzer(const StreamingAnalyzer&) = delete;
+    StreamingAnalyzer& operator=(const StreamingAnalyzer&) = delete;
+
+    void declare_global(VariableNode* var) {
+        globals.push_back(var);
+        if (!global.add(var->name, var->type, var)) {
+            declaration_error(ScopeError::VariableRedefined, var->name, var->loc);
+        }
+    }
+
+    // Declares func's name, return type and parameters; its body, if any,
+    // is not looked at.
+    void declare_function(const FunctionNode& func) {
+        signatures.emplace_back(func.return_type, func.name);
+        FunctionNode& signature = signatures.back();
+        signature.loc = func.loc;
+        signature.params.reserve(func.params.size());
+        for (auto& param : func.params) {
+            signature.params.emplace_back(param.type, param.name);
+            signature.params.back().loc = param.loc;
+        }
+        if (!global.add_function(signature)) {
+            declaration_error(ScopeError::FunctionRedefined, signature.name, signature.loc);
+        }
+    }
+
+    // Checks one function body. Calls inside it resolve to the declared
+    // signatures. Returns false once any error has been found.
+    bool check_body(FunctionNode* func) {
+        if (limit_reached()) return false;
+        walker.limit_errors(remaining());
+        walker.check_function(func);
+        if (options.check_types) types.check_function(func);
+        take(walker.errors);
+        return found() == 0;
+    }
+
+    // Checks the global initializers and completes the analysis.
+    bool finish() {
+        ScopeWalker initializers(global, &global);
+        for (VariableNode* var : globals) {
+            if (!var->value) continue;
+            if (limit_reached()) break;
+            initializers.limit_errors(remaining());
+            initializers.check_node(var->value);
+            if (options.check_types) types.check_global(var);
+            take(initializers.errors);
+        }
+        if (options.verdict_only) {
+            failed = found() != 0;
+            errors.clear();
+            type_errors.clear();
+        }
+        return passed();
+    }
+
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+    const std::vector<TypeDiagnostic>& getTypeErrors() const { return type_errors; }
+    bool passed() const { return !failed && errors.empty() && type_errors.empty(); }
+    size_t errorCount() const { return errors.size(); }
+};
+
+#endif
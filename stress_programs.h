@@ -0,0 +1,338 @@
+#ifndef STRESS_PROGRAMS_H
+#define STRESS_PROGRAMS_H
+
+#include "diagnostics.h"
+#include "parse_tree.h"
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Pathological program shapes for checking that the analyzer stays linear
+// where random programs never go: very deep nesting, very long operator
+// chains, huge scopes and names shadowed at every level. Each shape also
+// contains a few deliberate errors so the diagnostic paths are exercised.
+enum class StressShape {
+    DeepBlocks,   // `size` nested blocks, each redeclaring the same name
+    LongChain,    // a `size`-term left-deep + chain, and a right-deep one
+    ManyLocals,   // one block declaring `size` locals
+    Shadowing     // nested blocks and for loops, 100 names redeclared per level; `size` declarations
+};
+
+inline const char* stress_shape_name(StressShape shape) {
+    switch (shape) {
+        case StressShape::DeepBlocks: return "deep-blocks";
+        case StressShape::LongChain: return "long-chain";
+        case StressShape::ManyLocals: return "many-locals";
+        case StressShape::Shadowing: return "shadowing";
+    }
+    return "unknown";
+}
+
+// Builds one shape into a program. Nodes are built in loops, never by
+// recursion, so any size can be built.
+class StressBuilder {
+    ProgramNode* program = nullptr;
+    size_t nodes = 0;
+    uint32_t line = 0;
+    const Symbol int_type = "int";
+
+    template<typename T, typename... Args>
+    T* node(Args&&... args) {
+        ++nodes;
+        T* n = program->make<T>(std::forward<Args>(args)...);
+        n->loc = {++line, 1};
+        return n;
+    }
+
+    static Symbol numbered(const char* prefix, size_t i) { return Symbol(prefix + std::to_string(i)); }
+
+    BinaryOpNode* binary(ASTNode* left, ASTNode* right) {
+        auto bin = node<BinaryOpNode>("+");
+        bin->left = left;
+        bin->right = right;
+        return bin;
+    }
+
+    VariableNode* variable(Symbol name, ASTNode* value) {
+        auto var = node<VariableNode>(int_type, name);
+        var->value = value;
+        return var;
+    }
+
+    AssignmentNode* assignment(Symbol name, ASTNode* value) {
+        auto assign = node<AssignmentNode>(name);
+        assign->value = value;
+        return assign;
+    }
+
+    FunctionNode& function(const char* name, std::initializer_list<const char*> params) {
+        FunctionNode& func = program->add_function(int_type, Symbol(name));
+        func.loc = {++line, 1};
+        ++nodes;
+        for (const char* p : params) {
+            func.params.emplace_back(int_type, Symbol(p));
+            func.params.back().loc = {++line, 1};
+            ++nodes;
+        }
+        return func;
+    }
+
+    void deep_blocks(size_t depth) {
+        Symbol x = "x", g = "g", p = "p";
+        FunctionNode& func = function("deep", {"p"});
+        std::vector<BlockNode*> blocks;
+        blocks.reserve(depth);
+        BlockNode* parent = nullptr;
+        for (size_t i = 0; i < depth; ++i) {
+            auto block = node<BlockNode>();
+            block->statements.push_back(variable(x, binary(node<NameNode>(x), node<NameNode>(g))));
+            if (i % 1000 == 999) block->statements.push_back(node<NameNode>(numbered("missing", i)));
+            if (parent) parent->statements.push_back(block);
+            else func.body = block;
+            blocks.push_back(block);
+            parent = block;
+        }
+        auto call = node<CallNode>(Symbol("deep"));
+        call->args.push_back(node<NameNode>(x));
+        blocks.back()->statements.push_back(call);
+        for (BlockNode* block : blocks) block->statements.push_back(assignment(x, node<NameNode>(p)));
+    }
+
+    void long_chain(size_t terms) {
+        Symbol a = "a", b = "b", g = "g";
+        FunctionNode& func = function("chain", {"a", "b"});
+        ASTNode* left = node<NameNode>(a);
+        for (size_t i = 1; i < terms; ++i) {
+            Symbol name = i % (terms / 4 + 1) == 0 ? numbered("missing", i) : (i % 2 ? b : a);
+            left = binary(left, node<NameNode>(name));
+        }
+        auto ret = node<ReturnNode>();
+        ret->value = left;
+        auto body = node<BlockNode>();
+        body->statements.push_back(ret);
+        func.body = body;
+
+        // Right-deep, as a global initializer.
+        VariableNode& total = program->globals.back();
+        ASTNode* right = node<NameNode>(g);
+        for (size_t i = 1; i < terms / 4; ++i) right = binary(node<NameNode>(g), right);
+        total.value = right;
+    }
+
+    void many_locals(size_t count) {
+        FunctionNode& func = function("locals", {"p"});
+        auto body = node<BlockNode>();
+        body->statements.reserve(count + 1);
+        Symbol previous = "p";
+        std::vector<Symbol> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            Symbol name = numbered("v", i);
+            body->statements.push_back(variable(name, binary(node<NameNode>(previous), node<NameNode>(Symbol("g")))));
+            if (i % 10000 == 9999) {
+                body->statements.push_back(variable(names[i / 2], nullptr));          // redefinition
+                body->statements.push_back(assignment(numbered("missing", i), node<NameNode>(previous)));
+            }
+            names.push_back(name);
+            previous = name;
+        }
+        auto ret = node<ReturnNode>();
+        ret->value = binary(node<NameNode>(previous), node<NameNode>(names.front()));
+        body->statements.push_back(ret);
+        func.body = body;
+    }
+
+    void shadowing(size_t declarations) {
+        const size_t kNames = 100;
+        std::vector<Symbol> names;
+        for (size_t k = 0; k < kNames; ++k) names.push_back(numbered("s", k));
+        FunctionNode& func = function("shadow", {"s0", "p"});
+        size_t depth = declarations / kNames + 1;
+        std::vector<ASTNode*>* statements = nullptr;
+        for (size_t d = 0; d < depth; ++d) {
+            auto block = node<BlockNode>();
+            block->statements.reserve(2 * kNames + 2);
+            for (size_t k = 0; k < kNames; ++k) {
+                // Initialized from the outer declaration of the next name.
+                Symbol next = names[(k + 1) % kNames];
+                block->statements.push_back(variable(names[k], binary(node<NameNode>(next), node<NameNode>(Symbol("p")))));
+            }
+            for (size_t k = 0; k < kNames; ++k) block->statements.push_back(assignment(names[k], node<NameNode>(Symbol("g"))));
+            if (d % 100 == 99) block->statements.push_back(node<NameNode>(numbered("missing", d)));
+            if (!statements) {
+                func.body = block;
+            } else if (d % 2) {
+                // for (int s0 = s1; s0; s0 = s2) { ... }
+                auto loop = node<ForNode>();
+                loop->initializer = variable(names[0], node<NameNode>(names[1]));
+                loop->condition = node<NameNode>(names[0]);
+                loop->increment = assignment(names[0], node<NameNode>(names[2]));
+                loop->body = block;
+                statements->push_back(loop);
+            } else {
+                statements->push_back(block);
+            }
+            statements = &block->statements;
+        }
+    }
+
+public:
+    // Replaces out's contents with shape at the given size and returns the
+    // number of nodes built. All shapes declare the global `g`.
+    size_t build(StressShape shape, size_t size, ProgramNode& out) {
+        out.clear();
+        program = &out;
+        nodes = 0;
+        line = 0;
+        out.reserve(1, 2);
+        out.add_global(int_type, Symbol("g")).loc = {++line, 1};
+        out.add_global(int_type, Symbol("total")).loc = {++line, 1};
+        nodes += 2;
+        switch (shape) {
+            case StressShape::DeepBlocks: deep_blocks(size); break;
+            case StressShape::LongChain: long_chain(size); break;
+            case StressShape::ManyLocals: many_locals(size); break;
+            case StressShape::Shadowing: shadowing(size); break;
+        }
+        return nodes;
+    }
+};
+
+// Deliberately simple scope resolution to compare the analyzer against:
+// one hash map from names to a stack of declarations, and a list of the
+// names each open scope declared. Gives the same diagnostics, in the same
+// order, as ScopeAnalyzer::check without type checking, and counts the
+// NameNode, AssignmentNode and CallNode links that differ from its own.
+class ReferenceChecker {
+    struct Declaration {
+        size_t scope;
+        const ASTNode* decl;
+    };
+
+    std::unordered_map<Symbol, std::vector<Declaration>> visible;
+    std::vector<std::vector<Symbol>> scopes;
+    std::unordered_map<Symbol, const FunctionNode*> functions;
+
+    void open() { scopes.emplace_back(); }
+
+    void close() {
+        for (Symbol name : scopes.back()) visible[name].pop_back();
+        scopes.pop_back();
+    }
+
+    bool in_innermost(Symbol name) {
+        auto it = visible.find(name);
+        return it != visible.end() && !it->second.empty() && it->second.back().scope == scopes.size() - 1;
+    }
+
+    bool declare(Symbol name, const ASTNode* decl) {
+        if (in_innermost(name)) return false;
+        visible[name].push_back({scopes.size() - 1, decl});
+        scopes.back().push_back(name);
+        return true;
+    }
+
+    const ASTNode* lookup(Symbol name) {
+        auto it = visible.find(name);
+        return it == visible.end() || it->second.empty() ? nullptr : it->second.back().decl;
+    }
+
+    void walk(ASTNode* root) {
+        enum Action { Visit, Close, Resolve };
+        std::vector<std::pair<Action, ASTNode*>> stack;
+        stack.push_back({Visit, root});
+        while (!stack.empty()) {
+            auto [action, node] = stack.back();
+            stack.pop_back();
+            if (action == Close) {
+                close();
+                continue;
+            }
+            if (action == Resolve) {
+                auto assign = static_cast<AssignmentNode*>(node);
+                const ASTNode* decl = lookup(assign->name);
+                if (!decl) errors.push_back({ScopeError::UndeclaredVariable, assign->name, assign->loc});
+                if (decl != assign->decl) ++wrong_links;
+                continue;
+            }
+            if (!node) continue;
+
+            size_t mark = stack.size();
+            switch (node->kind()) {
+                case NodeKind::Block:
+                case NodeKind::For:
+                    open();
+                    stack.push_back({Close, nullptr});
+                    mark = stack.size();
+                    break;
+                case NodeKind::Variable: {
+                    auto var = static_cast<VariableNode*>(node);
+                    if (!declare(var->name, var)) errors.push_back({ScopeError::VariableRedefined, var->name, var->loc});
+                    break;
+                }
+                case NodeKind::Name: {
+                    auto name = static_cast<NameNode*>(node);
+                    const ASTNode* decl = lookup(name->name);
+                    if (!decl) errors.push_back({ScopeError::UndeclaredVariable, name->name, name->loc});
+                    if (decl != name->decl) ++wrong_links;
+                    break;
+                }
+                case NodeKind::Call: {
+                    auto call = static_cast<CallNode*>(node);
+                    auto it = functions.find(call->name);
+                    const FunctionNode* callee = it == functions.end() ? nullptr : it->second;
+                    if (!callee) errors.push_back({ScopeError::UndefinedFunction, call->name, call->loc});
+                    if (callee != call->callee) ++wrong_links;
+                    break;
+                }
+                case NodeKind::Assignment:
+                    stack.push_back({Resolve, node});
+                    mark = stack.size();
+                    break;
+                default:
+                    break;
+            }
+            // Children go on the stack in reverse so they are visited in order.
+            for_each_child(node, [&](const ASTNode* child) {
+                stack.push_back({Visit, const_cast<ASTNode*>(child)});
+            });
+            std::reverse(stack.begin() + mark, stack.end());
+        }
+    }
+
+public:
+    std::vector<Diagnostic> errors;
+    size_t wrong_links = 0;
+
+    void check(ProgramNode& program) {
+        errors.clear();
+        wrong_links = 0;
+        visible.clear();
+        functions.clear();
+        scopes.clear();
+        open();
+        for (auto& var : program.globals) {
+            if (!declare(var.name, &var)) errors.push_back({ScopeError::VariableRedefined, var.name, var.loc});
+        }
+        for (auto& func : program.functions) {
+            if (!functions.emplace(func.name, &func).second) {
+                errors.push_back({ScopeError::FunctionRedefined, func.name, func.loc});
+            }
+        }
+        for (auto& func : program.functions) {
+            open();
+            for (auto& param : func.params) {
+                if (!declare(param.name, &param)) errors.push_back({ScopeError::VariableRedefined, param.name, param.loc});
+            }
+            walk(func.body);
+            close();
+        }
+        for (auto& var : program.globals) {
+            if (var.value) walk(var.value);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// 64-bit FNV-1a. Stable across processes, so it can key on-disk data.
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t h = 14695981039346656037ull) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Process-wide table of identifier and type names. Each distinct string is
+// stored once and gets a small dense id; id 0 is the empty string.
+class Interner {
+    mutable std::mutex mutex;
+    std::deque<std::string> strings;   // deque keeps the keys below stable
+    std::deque<uint64_t> hashes;       // fnv1a of each string
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+public:
+    Interner() {
+        strings.emplace_back();
+        hashes.push_back(fnv1a(nullptr, 0));
+        ids.emplace(strings.back(), 0);
+    }
+
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    uint32_t intern(std::string_view text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(text);
+        if (it != ids.end()) return it->second;
+        uint32_t id = (uint32_t)strings.size();
+        strings.emplace_back(text);
+        hashes.push_back(fnv1a(text.data(), text.size()));
+        ids.emplace(strings.back(), id);
+        return id;
+    }
+
+    const std::string& text(uint32_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return strings[id];
+    }
+
+    uint64_t text_hash(uint32_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hashes[id];
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return strings.size();
+    }
+
+    // Estimated heap bytes: the strings, their hashes and the id map.
+    size_t memory_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const size_t inline_capacity = std::string().capacity();
+        size_t bytes = strings.size() * (sizeof(std::string) + sizeof(uint64_t));
+        for (auto& s : strings) {
+            if (s.capacity() > inline_capacity) bytes += s.capacity() + 1;
+        }
+        bytes += ids.bucket_count() * sizeof(void*);
+        bytes += ids.size() * (sizeof(std::pair<const std::string_view, uint32_t>) + sizeof(void*));
+        return bytes;
+    }
+};
+
+inline Interner& interner() {
+    static Interner instance;
+    return instance;
+}
+
+// Interned name. Comparing and hashing a Symbol is an integer operation;
+// the text is only needed when reporting.
+struct Symbol {
+    uint32_t id = 0;
+
+    Symbol() = default;
+    Symbol(const char* text) : id(interner().intern(text)) {}
+    Symbol(const std::string& text) : id(interner().intern(text)) {}
+    Symbol(std::string_view text) : id(interner().intern(text)) {}
+
+    static Symbol from_id(uint32_t id) {
+        Symbol s;
+        s.id = id;
+        return s;
+    }
+
+    const std::string& str() const { return interner().text(id); }
+    // Hash of the text rather than the id, for keys that outlive the process.
+    uint64_t stable_hash() const { return interner().text_hash(id); }
+    bool empty() const { return id == 0; }
+
+    bool operator==(Symbol other) const { return id == other.id; }
+    bool operator!=(Symbol other) const { return id != other.id; }
+    bool operator<(Symbol other) const { return id < other.id; }
+};
+
+namespace std {
+template<>
+struct hash<Symbol> {
+    size_t operator()(Symbol s) const noexcept { return s.id; }
+};
+}
+
+#endif
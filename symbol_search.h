@@ -0,0 +1,108 @@
+#ifndef SYMBOL_SEARCH_H
+#define SYMBOL_SEARCH_H
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYMBOL_SEARCH_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SYMBOL_SEARCH_NEON 1
+#endif
+
+// Linear search for one symbol id in a short array of ids, the inner loop
+// of small-scope lookups. The vector kernels compare 4 (SSE2, NEON) or 8
+// (AVX2) ids per instruction; the widest one the CPU supports is picked
+// once at startup. Arrays shorter than kVectorMin are scanned inline
+// since the indirect call would cost more than the loop.
+namespace symbol_search {
+
+using Kernel = int (*)(const uint32_t* ids, uint32_t count, uint32_t id);
+
+static constexpr uint32_t kVectorMin = 8;
+
+inline int scalar(const uint32_t* ids, uint32_t count, uint32_t id) {
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ids[i] == id) return (int)i;
+    }
+    return -1;
+}
+
+#if SYMBOL_SEARCH_X86
+__attribute__((target("sse2")))
+inline int sse2(const uint32_t* ids, uint32_t count, uint32_t id) {
+    __m128i needle = _mm_set1_epi32((int)id);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)));
+        if (mask) return (int)(i + __builtin_ctz((unsigned)mask));
+    }
+    int rest = scalar(ids + i, count - i, id);
+    return rest < 0 ? -1 : (int)i + rest;
+}
+
+__attribute__((target("avx2")))
+inline int avx2(const uint32_t* ids, uint32_t count, uint32_t id) {
+    __m256i needle = _mm256_set1_epi32((int)id);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle)));
+        if (mask) return (int)(i + __builtin_ctz((unsigned)mask));
+    }
+    int rest = sse2(ids + i, count - i, id);
+    return rest < 0 ? -1 : (int)i + rest;
+}
+#endif
+
+#if SYMBOL_SEARCH_NEON
+inline int neon(const uint32_t* ids, uint32_t count, uint32_t id) {
+    uint32x4_t needle = vdupq_n_u32(id);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t eq = vceqq_u32(vld1q_u32(ids + i), needle);
+        if (vmaxvq_u32(eq)) return (int)i + scalar(ids + i, 4, id);
+    }
+    int rest = scalar(ids + i, count - i, id);
+    return rest < 0 ? -1 : (int)i + rest;
+}
+#endif
+
+inline Kernel select_kernel() {
+#if SYMBOL_SEARCH_X86
+    if (__builtin_cpu_supports("avx2")) return avx2;
+    return sse2;
+#elif SYMBOL_SEARCH_NEON
+    return neon;
+#else
+    return scalar;
+#endif
+}
+
+inline Kernel kernel() {
+    static const Kernel selected = select_kernel();
+    return selected;
+}
+
+inline const char* kernel_name() {
+    Kernel k = kernel();
+#if SYMBOL_SEARCH_X86
+    if (k == avx2) return "avx2";
+    if (k == sse2) return "sse2";
+#elif SYMBOL_SEARCH_NEON
+    if (k == neon) return "neon";
+#endif
+    return "scalar";
+}
+
+}
+
+// Index of the first element of ids[0, count) equal to id, or -1.
+inline int find_symbol_id(const uint32_t* ids, uint32_t count, uint32_t id) {
+    if (count < symbol_search::kVectorMin) return symbol_search::scalar(ids, count, id);
+    return symbol_search::kernel()(ids, count, id);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Resolves a requested worker count; 0 means one per hardware thread.
+inline unsigned resolve_thread_count(unsigned requested) {
+    if (requested != 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1;
+}
+
+// Runs body(worker, index) for every index in [0, count) on up to
+// `threads` workers. Indices are handed out dynamically, one at a time, so
+// uneven items balance across workers. Returns once every item is done.
+template<typename Body>
+void parallel_for(size_t count, unsigned threads, Body&& body) {
+    unsigned workers = (unsigned)std::min<size_t>(resolve_thread_count(threads), count);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; ++i) body(0u, i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto run = [&](unsigned worker) {
+        for (size_t i = next++; i < count; i = next++) body(worker, i);
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (unsigned w = 1; w < workers; ++w) pool.emplace_back(run, w);
+    run(0);
+    for (auto& t : pool) t.join();
+}
+
+#endif
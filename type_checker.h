@@ -0,0 +1,505 @@
+#ifndef TYPE_CHECKER_H
+#define TYPE_CHECKER_H
+
+#include "parse_tree.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Same error set as type-checker.py. ErroneousBreak and the unary-operator
+// cases cannot occur on this AST (it has no break or unary nodes) but are
+// kept so codes line up with the Python tool.
+enum class TypeError {
+    ErroneousVarDecl = 1,
+    FnCallParamCount,
+    FnCallParamType,
+    ErroneousReturnType,
+    ExpressionTypeMismatch,
+    ExpectedBooleanExpression,
+    ErroneousBreak,
+    NonBooleanCondStmt,
+    EmptyExpression,
+    AttemptedBoolOpOnNonBools,
+    AttemptedBitOpOnNonNumeric,
+    AttemptedShiftOnNonInt,
+    AttemptedAddOpOnNonNumeric,
+    AttemptedExponentiationOfNonNumeric,
+    ReturnStmtNotFound
+};
+
+enum class BasicType : uint8_t {
+    Int,
+    Float,
+    Bool,
+    String,
+    Void,
+    Unknown,
+    Error       // an operand whose error is already reported; see TypeChecker
+};
+
+inline const char* basic_type_name(BasicType t) {
+    switch (t) {
+        case BasicType::Int: return "int";
+        case BasicType::Float: return "float";
+        case BasicType::Bool: return "bool";
+        case BasicType::String: return "string";
+        case BasicType::Void: return "void";
+        case BasicType::Unknown: return "unknown";
+        case BasicType::Error: return "error";
+    }
+    return "unknown";
+}
+
+inline const char* type_error_name(TypeError err) {
+    switch (err) {
+        case TypeError::ErroneousVarDecl: return "ErroneousVarDecl";
+        case TypeError::FnCallParamCount: return "FnCallParamCount";
+        case TypeError::FnCallParamType: return "FnCallParamType";
+        case TypeError::ErroneousReturnType: return "ErroneousReturnType";
+        case TypeError::ExpressionTypeMismatch: return "ExpressionTypeMismatch";
+        case TypeError::ExpectedBooleanExpression: return "ExpectedBooleanExpression";
+        case TypeError::ErroneousBreak: return "ErroneousBreak";
+        case TypeError::NonBooleanCondStmt: return "NonBooleanCondStmt";
+        case TypeError::EmptyExpression: return "EmptyExpression";
+        case TypeError::AttemptedBoolOpOnNonBools: return "AttemptedBoolOpOnNonBools";
+        case TypeError::AttemptedBitOpOnNonNumeric: return "AttemptedBitOpOnNonNumeric";
+        case TypeError::AttemptedShiftOnNonInt: return "AttemptedShiftOnNonInt";
+        case TypeError::AttemptedAddOpOnNonNumeric: return "AttemptedAddOpOnNonNumeric";
+        case TypeError::AttemptedExponentiationOfNonNumeric: return "AttemptedExponentiationOfNonNumeric";
+        case TypeError::ReturnStmtNotFound: return "ReturnStmtNotFound";
+    }
+    return "Unknown";
+}
+
+// `name` is the variable, function or operator involved; `expected` and
+// `actual` are filled in where the Python tool prints them.
+struct TypeDiagnostic {
+    TypeError kind;
+    SourceLocation loc;
+    Symbol name;
+    BasicType expected = BasicType::Unknown;
+    BasicType actual = BasicType::Unknown;
+};
+
+inline std::string type_error_message(const TypeDiagnostic& d) {
+    std::string msg = type_error_name(d.kind);
+    msg += ": ";
+    const std::string& name = d.name.str();
+    switch (d.kind) {
+        case TypeError::ErroneousVarDecl:
+            msg += name + ": declared " + basic_type_name(d.expected) + ", got " + basic_type_name(d.actual);
+            break;
+        case TypeError::FnCallParamCount:
+            msg += name + " called with the wrong number of arguments";
+            break;
+        case TypeError::FnCallParamType:
+            msg += "Argument of " + name + ": expected " + basic_type_name(d.expected) + ", got " + basic_type_name(d.actual);
+            break;
+        case TypeError::ErroneousReturnType:
+            msg += std::string("Expected ") + basic_type_name(d.expected) + ", got " + basic_type_name(d.actual);
+            break;
+        case TypeError::ExpressionTypeMismatch:
+            msg += name + ": expected " + basic_type_name(d.expected) + ", got " + basic_type_name(d.actual);
+            break;
+        case TypeError::NonBooleanCondStmt:
+            msg += std::string("Condition needs bool, got ") + basic_type_name(d.actual);
+            break;
+        case TypeError::EmptyExpression:
+            msg += "Empty expression";
+            break;
+        case TypeError::ReturnStmtNotFound:
+            msg += "Function " + name + " needs return";
+            break;
+        default:
+            msg += "'" + name + "' applied to " + basic_type_name(d.actual);
+            break;
+    }
+    return msg;
+}
+
+// Native port of type-checker.py for the C++ AST. It does no name lookup
+// of its own: it reads the declarations the scope pass stored on NameNode,
+// AssignmentNode and CallNode, so it must run after ScopeWalker has
+// checked the same function (ScopeAnalyzer does this when
+// AnalyzerOptions::check_types is set).
+//
+// Names and calls the scope pass could not resolve are already reported
+// there, and an operator or empty expression that fails is reported
+// here. Either gives the expression the type Error, which passes every
+// check that uses it and makes enclosing operators Error too, so each
+// mistake is reported once.
+//
+// Like the scope walker, the traversal uses an explicit stack; expression
+// types are kept on a value stack in postorder.
+class TypeChecker {
+public:
+    std::vector<TypeDiagnostic> errors;
+
+    TypeChecker()
+        : int_type("int"), float_type("float"), bool_type("bool"),
+          string_type("string"), void_type("void") {}
+
+    void check_function(const FunctionNode* func) {
+        current_return = to_type(func->return_type);
+        has_return = false;
+        loop_depth = 0;
+        if (func->body) run(func->body, false);
+        check_return_found(func, has_return);
+    }
+
+    // Checks statements [begin, end) of func's body block, one piece of
+    // check_function for a function split across workers, and returns
+    // whether they hold a return statement. The pieces' results are
+    // combined through check_return_found().
+    bool check_function_part(const FunctionNode* func, size_t begin, size_t end) {
+        current_return = to_type(func->return_type);
+        has_return = false;
+        loop_depth = 0;
+        work.clear();
+        values.clear();
+        auto& stmts = static_cast<const BlockNode*>(func->body)->statements;
+        for (size_t i = end; i > begin; --i) push(Step::Statement, stmts[i - 1]);
+        drain();
+        return has_return;
+    }
+
+    void check_return_found(const FunctionNode* func, bool found) {
+        if (to_type(func->return_type) != BasicType::Void && !found) {
+            error(TypeError::ReturnStmtNotFound, func->loc, func->name);
+        }
+    }
+
+    // Type of a global's initializer against its declared type.
+    void check_global(const VariableNode* var) {
+        current_return = BasicType::Void;
+        has_return = false;
+        loop_depth = 0;
+        run(var, false);
+    }
+
+    BasicType to_type(Symbol name) const {
+        if (name == int_type) return BasicType::Int;
+        if (name == float_type) return BasicType::Float;
+        if (name == bool_type) return BasicType::Bool;
+        if (name == string_type) return BasicType::String;
+        if (name == void_type) return BasicType::Void;
+        return BasicType::Unknown;
+    }
+
+private:
+    enum class Step : uint8_t {
+        Statement,      // node used as a statement
+        Expression,     // node whose type is pushed on `values`
+        FinishBinary,
+        FinishCall,
+        FinishVariable,
+        FinishAssignment,
+        FinishReturn,
+        FinishCondition,
+        Discard,
+        EnterLoop,
+        LeaveLoop
+    };
+    struct Task {
+        Step step;
+        const ASTNode* node;
+    };
+
+    Symbol int_type, float_type, bool_type, string_type, void_type;
+    std::vector<Task> work;
+    std::vector<BasicType> values;
+    BasicType current_return = BasicType::Void;
+    bool has_return = false;
+    size_t loop_depth = 0;
+
+    static bool is_numeric(BasicType t) { return t == BasicType::Int || t == BasicType::Float; }
+    // Whether a check of actual against expected can fail.
+    static bool mismatch(BasicType expected, BasicType actual) {
+        return actual != expected && actual != BasicType::Error && expected != BasicType::Error;
+    }
+    static bool is_expression(NodeKind k) {
+        return k == NodeKind::Name || k == NodeKind::Literal || k == NodeKind::BinaryOp || k == NodeKind::Call;
+    }
+
+    void error(TypeError kind, SourceLocation loc, Symbol name = Symbol(),
+               BasicType expected = BasicType::Unknown, BasicType actual = BasicType::Unknown) {
+        errors.push_back({kind, loc, name, expected, actual});
+    }
+
+    void push(Step step, const ASTNode* node) { work.push_back({step, node}); }
+
+    BasicType pop_value() {
+        BasicType t = values.back();
+        values.pop_back();
+        return t;
+    }
+
+    static BasicType literal_type(const LiteralNode* lit) {
+        switch (lit->type) {
+            case LiteralKind::Int: return BasicType::Int;
+            case LiteralKind::Float: return BasicType::Float;
+            case LiteralKind::Bool: return BasicType::Bool;
+            case LiteralKind::String: return BasicType::String;
+            case LiteralKind::Unknown: break;
+        }
+        return BasicType::Unknown;
+    }
+
+    BasicType declared_type(const ASTNode* decl) const {
+        if (!decl) return BasicType::Error;
+        if (decl->kind() != NodeKind::Variable) return BasicType::Unknown;
+        return to_type(static_cast<const VariableNode*>(decl)->type);
+    }
+
+    void run(const ASTNode* root, bool as_expression) {
+        work.clear();
+        values.clear();
+        push(as_expression ? Step::Expression : Step::Statement, root);
+        drain();
+    }
+
+    void drain() {
+        while (!work.empty()) {
+            Task task = work.back();
+            work.pop_back();
+            switch (task.step) {
+                case Step::Statement: statement(task.node); break;
+                case Step::Expression: expression(task.node); break;
+                case Step::EnterLoop: ++loop_depth; break;
+                case Step::LeaveLoop: --loop_depth; break;
+                case Step::Discard: pop_value(); break;
+                default: finish(task); break;
+            }
+        }
+    }
+
+    void statement(const ASTNode* node) {
+        if (!node) return;
+        if (is_expression(node->kind())) {
+            // Expression statement: evaluate for its errors, drop the type.
+            push(Step::Discard, nullptr);
+            push(Step::Expression, node);
+            return;
+        }
+        switch (node->kind()) {
+            case NodeKind::Block: {
+                auto& stmts = static_cast<const BlockNode*>(node)->statements;
+                for (auto it = stmts.rbegin(); it != stmts.rend(); ++it) push(Step::Statement, *it);
+                break;
+            }
+            case NodeKind::Variable: {
+                auto var = static_cast<const VariableNode*>(node);
+                if (var->value) {
+                    push(Step::FinishVariable, var);
+                    push(Step::Expression, var->value);
+                }
+                break;
+            }
+            case NodeKind::Assignment: {
+                auto assign = static_cast<const AssignmentNode*>(node);
+                if (!assign->decl) break;
+                push(Step::FinishAssignment, assign);
+                push(Step::Expression, assign->value);
+                break;
+            }
+            case NodeKind::Return: {
+                auto ret = static_cast<const ReturnNode*>(node);
+                has_return = true;
+                if (current_return == BasicType::Void) {
+                    if (ret->value) error(TypeError::ErroneousReturnType, ret->loc, Symbol(), BasicType::Void);
+                } else if (!ret->value) {
+                    error(TypeError::ErroneousReturnType, ret->loc, Symbol(), current_return, BasicType::Void);
+                } else {
+                    push(Step::FinishReturn, ret);
+                    push(Step::Expression, ret->value);
+                }
+                break;
+            }
+            case NodeKind::If: {
+                auto if_stmt = static_cast<const IfNode*>(node);
+                push(Step::Statement, if_stmt->else_branch);
+                push(Step::Statement, if_stmt->then_branch);
+                push(Step::FinishCondition, if_stmt);
+                push(Step::Expression, if_stmt->condition);
+                break;
+            }
+            case NodeKind::While: {
+                auto while_stmt = static_cast<const WhileNode*>(node);
+                push(Step::LeaveLoop, nullptr);
+                push(Step::Statement, while_stmt->body);
+                push(Step::EnterLoop, nullptr);
+                push(Step::FinishCondition, while_stmt);
+                push(Step::Expression, while_stmt->condition);
+                break;
+            }
+            case NodeKind::For: {
+                auto for_stmt = static_cast<const ForNode*>(node);
+                push(Step::LeaveLoop, nullptr);
+                push(Step::Statement, for_stmt->body);
+                push(Step::Statement, for_stmt->increment);
+                if (for_stmt->condition) {
+                    push(Step::FinishCondition, for_stmt);
+                    push(Step::Expression, for_stmt->condition);
+                }
+                push(Step::Statement, for_stmt->initializer);
+                push(Step::EnterLoop, nullptr);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void expression(const ASTNode* node) {
+        if (!node) {
+            error(TypeError::EmptyExpression, SourceLocation());
+            values.push_back(BasicType::Error);
+            return;
+        }
+        switch (node->kind()) {
+            case NodeKind::Literal:
+                values.push_back(literal_type(static_cast<const LiteralNode*>(node)));
+                break;
+            case NodeKind::Name:
+                values.push_back(declared_type(static_cast<const NameNode*>(node)->decl));
+                break;
+            case NodeKind::BinaryOp: {
+                auto binary = static_cast<const BinaryOpNode*>(node);
+                push(Step::FinishBinary, binary);
+                push(Step::Expression, binary->right);
+                push(Step::Expression, binary->left);
+                break;
+            }
+            case NodeKind::Call: {
+                auto call = static_cast<const CallNode*>(node);
+                const FunctionNode* callee = call->callee;
+                if (!callee) {
+                    values.push_back(BasicType::Error);
+                } else if (call->args.size() != callee->params.size()) {
+                    error(TypeError::FnCallParamCount, call->loc, call->name);
+                    values.push_back(to_type(callee->return_type));
+                } else {
+                    push(Step::FinishCall, call);
+                    for (auto it = call->args.rbegin(); it != call->args.rend(); ++it) push(Step::Expression, *it);
+                }
+                break;
+            }
+            default:
+                values.push_back(BasicType::Unknown);
+                break;
+        }
+    }
+
+    void finish(const Task& task) {
+        switch (task.step) {
+            case Step::FinishBinary: {
+                auto binary = static_cast<const BinaryOpNode*>(task.node);
+                BasicType right = pop_value();
+                BasicType left = pop_value();
+                values.push_back(binary_result(binary, left, right));
+                break;
+            }
+            case Step::FinishCall: {
+                auto call = static_cast<const CallNode*>(task.node);
+                size_t n = call->args.size();
+                size_t base = values.size() - n;
+                for (size_t i = 0; i < n; ++i) {
+                    BasicType expected = to_type(call->callee->params[i].type);
+                    if (mismatch(expected, values[base + i])) {
+                        error(TypeError::FnCallParamType, call->loc, call->name, expected, values[base + i]);
+                    }
+                }
+                values.resize(base);
+                values.push_back(to_type(call->callee->return_type));
+                break;
+            }
+            case Step::FinishVariable: {
+                auto var = static_cast<const VariableNode*>(task.node);
+                BasicType declared = to_type(var->type);
+                BasicType actual = pop_value();
+                if (mismatch(declared, actual)) {
+                    error(TypeError::ErroneousVarDecl, var->loc, var->name, declared, actual);
+                }
+                break;
+            }
+            case Step::FinishAssignment: {
+                auto assign = static_cast<const AssignmentNode*>(task.node);
+                BasicType target = declared_type(assign->decl);
+                BasicType actual = pop_value();
+                if (mismatch(target, actual)) {
+                    error(TypeError::ExpressionTypeMismatch, assign->loc, assign->name, target, actual);
+                }
+                break;
+            }
+            case Step::FinishReturn: {
+                BasicType actual = pop_value();
+                if (mismatch(current_return, actual)) {
+                    error(TypeError::ErroneousReturnType, task.node->loc, Symbol(), current_return, actual);
+                }
+                break;
+            }
+            case Step::FinishCondition: {
+                BasicType actual = pop_value();
+                if (mismatch(BasicType::Bool, actual)) {
+                    error(TypeError::NonBooleanCondStmt, task.node->loc, Symbol(), BasicType::Bool, actual);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    BasicType binary_result(const BinaryOpNode* binary, BasicType left, BasicType right) {
+        const std::string& op = binary->op;
+        SourceLocation loc = binary->loc;
+        if (left == BasicType::Error || right == BasicType::Error) return BasicType::Error;
+        bool any_float = left == BasicType::Float || right == BasicType::Float;
+
+        if (op == "+" || op == "-" || op == "*" || op == "/") {
+            if (!(is_numeric(left) && is_numeric(right))) {
+                error(TypeError::AttemptedAddOpOnNonNumeric, loc, Symbol(op), BasicType::Unknown, is_numeric(left) ? right : left);
+                return BasicType::Error;
+            }
+            return any_float ? BasicType::Float : BasicType::Int;
+        }
+        if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=") {
+            if (left != right) {
+                error(TypeError::ExpressionTypeMismatch, loc, Symbol(op), left, right);
+                return BasicType::Error;
+            }
+            return BasicType::Bool;
+        }
+        if (op == "&&" || op == "||") {
+            if (left != BasicType::Bool || right != BasicType::Bool) {
+                error(TypeError::AttemptedBoolOpOnNonBools, loc, Symbol(op), BasicType::Bool, left != BasicType::Bool ? left : right);
+                return BasicType::Error;
+            }
+            return BasicType::Bool;
+        }
+        if (op == "&" || op == "|" || op == "^") {
+            if (left != BasicType::Int || right != BasicType::Int) {
+                error(TypeError::AttemptedBitOpOnNonNumeric, loc, Symbol(op), BasicType::Int, left != BasicType::Int ? left : right);
+                return BasicType::Error;
+            }
+            return BasicType::Int;
+        }
+        if (op == "<<" || op == ">>") {
+            if (left != BasicType::Int || right != BasicType::Int) {
+                error(TypeError::AttemptedShiftOnNonInt, loc, Symbol(op), BasicType::Int, left != BasicType::Int ? left : right);
+                return BasicType::Error;
+            }
+            return BasicType::Int;
+        }
+        if (op == "**") {
+            if (!(is_numeric(left) && is_numeric(right))) {
+                error(TypeError::AttemptedExponentiationOfNonNumeric, loc, Symbol(op), BasicType::Unknown, is_numeric(left) ? right : left);
+                return BasicType::Error;
+            }
+            return any_float ? BasicType::Float : BasicType::Int;
+        }
+        return BasicType::Unknown;
+    }
+};
+
+#endif